@@ -231,6 +231,32 @@ etharp_tmr(void)
   }
 }
 
+/**
+ * Checks whether the ARP table holds entries aged by etharp_tmr().
+ * Static entries are not aged. The table is read without protection, so
+ * this can be called from a timer interrupt to skip the etharp_tmr()
+ * calls with nothing to do.
+ *
+ * @return 1 if etharp_tmr() has entries to age, 0 otherwise
+ */
+u8_t
+etharp_tmr_pending(void)
+{
+  int i;
+
+  for (i = 0; i < ARP_TABLE_SIZE; ++i) {
+    u8_t state = arp_table[i].state;
+    if (state != ETHARP_STATE_EMPTY
+#if ETHARP_SUPPORT_STATIC_ENTRIES
+        && (state != ETHARP_STATE_STATIC)
+#endif /* ETHARP_SUPPORT_STATIC_ENTRIES */
+       ) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
 /**
  * Search the ARP table for a matching or new entry.
  *
@@ -657,6 +657,31 @@ igmp_tmr(void)
   }
 }
 
+/**
+ * Checks whether a group has a report delayed, i.e. whether igmp_tmr()
+ * has work to do. The lists are read without protection, so this can be
+ * called from a timer interrupt.
+ *
+ * @return 1 if a group has its timer running, 0 otherwise
+ */
+u8_t
+igmp_tmr_pending(void)
+{
+  struct netif *netif;
+
+  NETIF_FOREACH(netif) {
+    struct igmp_group *group = netif_igmp_data(netif);
+
+    while (group != NULL) {
+      if (group->timer > 0) {
+        return 1;
+      }
+      group = group->next;
+    }
+  }
+  return 0;
+}
+
 /**
  * Called if a timeout for one group is reached.
  * Sends a report for this group.
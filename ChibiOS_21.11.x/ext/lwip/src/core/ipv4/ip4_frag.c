@@ -151,6 +151,19 @@ ip_reass_tmr(void)
   }
 }
 
+/**
+ * Checks whether datagrams are being reassembled, i.e. whether
+ * ip_reass_tmr() has work to do. The list head is read without
+ * protection, so this can be called from a timer interrupt.
+ *
+ * @return 1 if datagrams are being reassembled, 0 otherwise
+ */
+u8_t
+ip_reass_tmr_pending(void)
+{
+  return reassdatagrams != NULL;
+}
+
 /**
  * Free a datagram (struct ip_reassdata) and all its pbufs.
  * Updates the total count of enqueued pbufs (ip_reass_pbufcount),
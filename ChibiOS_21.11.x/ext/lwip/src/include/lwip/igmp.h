@@ -98,6 +98,7 @@ err_t  igmp_joingroup_netif(struct netif *netif, const ip4_addr_t *groupaddr);
 err_t  igmp_leavegroup(const ip4_addr_t *ifaddr, const ip4_addr_t *groupaddr);
 err_t  igmp_leavegroup_netif(struct netif *netif, const ip4_addr_t *groupaddr);
 void   igmp_tmr(void);
+u8_t   igmp_tmr_pending(void);
 
 /** @ingroup igmp 
  * Get list head of IGMP groups for netif.
@@ -38,6 +38,16 @@
 #define MAC_FLAGS_RX                (1U << 1)
 /** @} */
 
+/**
+ * @brief   Value of the @p nsec field of a missing timestamp.
+ */
+#define MAC_TIMESTAMP_INVALID       0xFFFFFFFFU
+
+/**
+ * @brief   Number of bins of the occupancy histograms.
+ */
+#define MAC_OCCUPANCY_BINS          8U
+
 /*===========================================================================*/
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
@@ -53,6 +63,43 @@
 #define MAC_USE_ZERO_COPY           FALSE
 #endif
 
+/**
+ * @brief   Enables the scatter-gather transmit API.
+ * @details Frames are transmitted directly from a list of buffers without
+ *          copying them into the MAC buffers.
+ */
+#if !defined(MAC_USE_SCATTER_GATHER) || defined(__DOXYGEN__)
+#define MAC_USE_SCATTER_GATHER      FALSE
+#endif
+
+/**
+ * @brief   Enables the hardware receive filters API.
+ */
+#if !defined(MAC_USE_FILTERS) || defined(__DOXYGEN__)
+#define MAC_USE_FILTERS             FALSE
+#endif
+
+/**
+ * @brief   Enables the hardware timestamping of frames.
+ */
+#if !defined(MAC_USE_TIMESTAMPS) || defined(__DOXYGEN__)
+#define MAC_USE_TIMESTAMPS          FALSE
+#endif
+
+/**
+ * @brief   Enables the hardware statistics API.
+ */
+#if !defined(MAC_USE_STATISTICS) || defined(__DOXYGEN__)
+#define MAC_USE_STATISTICS          FALSE
+#endif
+
+/**
+ * @brief   Enables the descriptor rings occupancy statistics API.
+ */
+#if !defined(MAC_USE_RING_STATISTICS) || defined(__DOXYGEN__)
+#define MAC_USE_RING_STATISTICS     FALSE
+#endif
+
 /**
  * @brief   Enables an event sources for incoming packets.
  */
@@ -89,6 +136,147 @@ typedef struct hal_mac_transmit_descriptor MACTransmitDescriptor;
  */
 typedef struct hal_mac_receive_descriptor MACReceiveDescriptor;
 
+/**
+ * @brief   Receive filter modes.
+ */
+typedef enum {
+  MAC_FILTER_NORMAL = 0,            /**< Unicast, broadcast and registered
+                                         multicast addresses.               */
+  MAC_FILTER_ALL_MULTICAST = 1,     /**< All multicast addresses.           */
+  MAC_FILTER_PROMISCUOUS = 2        /**< All frames.                        */
+} macfiltermode_t;
+
+/**
+ * @brief   Type of a frame timestamp.
+ */
+typedef struct {
+  /**
+   * @brief   Seconds.
+   */
+  uint32_t                  sec;
+  /**
+   * @brief   Nanoseconds, @p MAC_TIMESTAMP_INVALID if the timestamp is not
+   *          available.
+   */
+  uint32_t                  nsec;
+} mactimestamp_t;
+
+/**
+ * @brief   Type of the MAC statistics.
+ * @note    Counters not supported by the hardware are left to zero.
+ */
+typedef struct {
+  /**
+   * @brief   Frames transmitted without errors.
+   */
+  uint64_t                  tx_frames;
+  /**
+   * @brief   Frames transmitted after one or more collisions.
+   */
+  uint64_t                  tx_collisions;
+  /**
+   * @brief   Unicast frames received without errors.
+   */
+  uint64_t                  rx_unicast_frames;
+  /**
+   * @brief   Frames received with CRC errors.
+   */
+  uint64_t                  rx_crc_errors;
+  /**
+   * @brief   Frames received with alignment errors.
+   */
+  uint64_t                  rx_alignment_errors;
+  /**
+   * @brief   Frames dropped because the MAC receive FIFO overflowed.
+   */
+  uint64_t                  rx_fifo_overflows;
+  /**
+   * @brief   Frames dropped because no receive descriptors were available.
+   */
+  uint64_t                  rx_missed_frames;
+  /**
+   * @brief   Frames dropped by the driver because of checksum errors.
+   */
+  uint64_t                  rx_checksum_errors;
+  /**
+   * @brief   Receive events found the MAC receive FIFO above the flow
+   *          control activation threshold, pause frames were being sent.
+   */
+  uint64_t                  rx_flow_control_events;
+  /**
+   * @brief   A hardware counter wrapped before being collected, some
+   *          events have been lost.
+   */
+  bool                      overflow;
+} macstatistics_t;
+
+/**
+ * @brief   Type of the occupancy statistics of a ring or a pool.
+ * @details The occupancy is sampled on the events changing it and when the
+ *          statistics are read. The last histogram bin counts the samples
+ *          with all the entries in use, the other bins split the lower
+ *          occupancies evenly.
+ */
+typedef struct {
+  /**
+   * @brief   Number of entries.
+   */
+  uint32_t                  size;
+  /**
+   * @brief   Entries in use at the last sample.
+   */
+  uint32_t                  used;
+  /**
+   * @brief   Maximum number of entries found in use.
+   */
+  uint32_t                  high_water;
+  /**
+   * @brief   Number of times all the entries have been found in use after
+   *          a sample with free entries.
+   */
+  uint32_t                  full_events;
+  /**
+   * @brief   Time spent with all the entries in use, in system ticks.
+   */
+  uint64_t                  full_time;
+  /**
+   * @brief   System time of the last sample.
+   */
+  systime_t                 last;
+  /**
+   * @brief   Occupancy histogram.
+   */
+  uint32_t                  histogram[MAC_OCCUPANCY_BINS];
+} macoccupancy_t;
+
+/**
+ * @brief   Type of the descriptor rings occupancy statistics.
+ */
+typedef struct {
+  /**
+   * @brief   Receive ring, descriptors holding frames not yet released.
+   */
+  macoccupancy_t            rx;
+  /**
+   * @brief   Transmit ring, descriptors locked or waiting for the DMA.
+   */
+  macoccupancy_t            tx;
+} macringstatistics_t;
+
+/**
+ * @brief   Type of a buffer composing a scatter-gather frame.
+ */
+typedef struct {
+  /**
+   * @brief   Pointer to the buffer data.
+   */
+  const uint8_t             *buf;
+  /**
+   * @brief   Buffer size in bytes.
+   */
+  size_t                    size;
+} macbuffer_t;
+
 /**
  * @brief   Generic ETH notification callback type.
  *
@@ -196,6 +384,12 @@ struct hal_mac_receive_descriptor {
    * @brief   Available data size.
    */
   size_t                    size;
+#if (MAC_USE_TIMESTAMPS == TRUE) || defined(__DOXYGEN__)
+  /**
+   * @brief   Frame reception timestamp.
+   */
+  mactimestamp_t            ts;
+#endif
   /* End of the mandatory fields.*/
   mac_lld_receive_descriptor_fields
 };
@@ -280,7 +474,7 @@ struct hal_mac_receive_descriptor {
  * @param[in] macp      pointer to the @p MACDriver object
  * @param[in] f         callback to be associated
  */
-#define macSetCallbackX(macp, f) (siop)->cb = (f)
+#define macSetCallbackX(macp, f) (macp)->cb = (f)
 
 /**
  * @brief   Returns the driver events source.
@@ -418,6 +612,60 @@ struct hal_mac_receive_descriptor {
 #define macGetNextReceiveBuffer(rdp, sizep)                                 \
   mac_lld_get_next_receive_buffer(rdp, sizep)
 #endif /* MAC_USE_ZERO_COPY */
+
+#if (MAC_USE_SCATTER_GATHER == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Enqueues a frame composed of multiple buffers for transmission.
+ * @details The buffers are transmitted in place, they must not be modified
+ *          or freed until the frame cookie is returned by
+ *          @p macReclaimTransmitBuffersI().
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] bp        pointer to an array of @p macbuffer_t structures
+ * @param[in] n         number of buffers in the array, it cannot exceed
+ *                      @p MAC_MAX_FRAME_BUFFERS
+ * @param[in] cookie    frame identifier, it must not be @p NULL
+ * @return              The operation status.
+ * @retval MSG_OK       the frame has been enqueued.
+ * @retval MSG_TIMEOUT  not enough descriptors available or too many frames
+ *                      not yet reclaimed.
+ * @retval MSG_RESET    the buffers are not accessible by the DMA, the frame
+ *                      must be copied.
+ *
+ * @iclass
+ */
+#define macTransmitBuffersI(macp, bp, n, cookie)                            \
+  mac_lld_transmit_buffers(macp, bp, n, cookie)
+
+/**
+ * @brief   Returns the cookie of a transmitted frame.
+ * @details The buffers of the returned frame can be reused or freed.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] tsp      pointer to the transmission timestamp of the frame,
+ *                      can be @p NULL
+ * @return              The cookie of a frame whose transmission has been
+ *                      completed.
+ * @retval NULL         if there are no more completed frames.
+ *
+ * @iclass
+ */
+#define macReclaimTransmitBuffersI(macp, tsp)                               \
+  mac_lld_reclaim_transmit_buffers(macp, tsp)
+#endif /* MAC_USE_SCATTER_GATHER */
+
+#if (MAC_USE_TIMESTAMPS == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the current time of the timestamping clock.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] tsp      pointer to the timestamp to be filled
+ *
+ * @xclass
+ */
+#define macGetTimestampX(macp, tsp)                                         \
+  mac_lld_get_timestamp(macp, tsp)
+#endif /* MAC_USE_TIMESTAMPS */
 /** @} */
 
 /*===========================================================================*/
@@ -441,6 +689,24 @@ extern "C" {
                                  sysinterval_t timeout);
   void macReleaseReceiveDescriptor(MACReceiveDescriptor *rdp);
   bool macPollLinkStatus(MACDriver *macp);
+#if MAC_USE_SCATTER_GATHER == TRUE
+  msg_t macTransmitBuffers(MACDriver *macp, const macbuffer_t *bp, size_t n,
+                           void *cookie, sysinterval_t timeout);
+  void *macReclaimTransmitBuffers(MACDriver *macp, mactimestamp_t *tsp);
+#endif
+#if MAC_USE_STATISTICS == TRUE
+  void macGetStatistics(MACDriver *macp, macstatistics_t *sp);
+#endif
+#if MAC_USE_RING_STATISTICS == TRUE
+  void macGetRingStatistics(MACDriver *macp, macringstatistics_t *rsp);
+#endif
+  void macOccupancyObjectInit(macoccupancy_t *op, uint32_t size);
+  void macOccupancySampleX(macoccupancy_t *op, uint32_t used);
+#if MAC_USE_FILTERS == TRUE
+  void macAddMulticastAddress(MACDriver *macp, const uint8_t *addr);
+  msg_t macRemoveMulticastAddress(MACDriver *macp, const uint8_t *addr);
+  void macSetFilterMode(MACDriver *macp, macfiltermode_t mode);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -67,7 +67,66 @@
 /* Driver local definitions.                                                 */
 /*===========================================================================*/
 
+#if STM32_MAC_BUFFERS_CACHED
+/* Buffers are made of whole cache lines so that maintenance operations do
+   not touch adjacent buffers.*/
+#define BUFFER_SIZE CACHE_SIZE_ALIGN(uint32_t, (STM32_MAC_BUFFERS_SIZE + 3) / 4)
+#define RX_BUFFER_SIZE CACHE_SIZE_ALIGN(uint32_t, STM32_MAC_RX_BUFFERS_SIZE / 4)
+#define BUFFER_ATTR __attribute__((aligned(CACHE_LINE_SIZE), __section__(".ram0")))
+#else
 #define BUFFER_SIZE ((((STM32_MAC_BUFFERS_SIZE - 1) | 3) + 1) / 4)
+#define RX_BUFFER_SIZE (STM32_MAC_RX_BUFFERS_SIZE / 4)
+#define BUFFER_ATTR __attribute__((aligned(4), __section__(".eth")))
+#endif
+
+/* Buffer associated to a receive descriptor, the DMA overwrites RDES0 on
+   write-back so the address is derived from the descriptor position.*/
+#define RDES_BUFFER(rdes) ((uint8_t *)__eth_rb[(rdes) - &__eth_rd[0]])
+
+/* Receive descriptor following another one in the ring.*/
+#define RDES_NEXT(rdes)     (((rdes) + 1) >= &__eth_rd[STM32_MAC_RECEIVE_BUFFERS] ? \
+                             &__eth_rd[0] : (rdes) + 1)
+
+#if STM32_MAC_FLOW_CONTROL
+/* Control frames are processed by the MAC and filtered, they must not
+   consume receive descriptors while the host is congested.*/
+#define MACPFR_PCF          ETH_MACPFR_PCF_BLOCKALL
+#define MTLRQOMR_FC         (ETH_MTLRQOMR_EHFC |                            \
+                             (STM32_MAC_RX_FC_ACTIVATE << ETH_MTLRQOMR_RFA_Pos) | \
+                             (STM32_MAC_RX_FC_DEACTIVATE << ETH_MTLRQOMR_RFD_Pos))
+#else
+#define MACPFR_PCF          0U
+#define MTLRQOMR_FC         0U
+#endif
+
+#if STM32_MAC_PHY_INTERRUPT
+#if BOARD_PHY_ID == MII_DP83848I_ID
+/* DP83848 interrupt registers, the status register is cleared on read.*/
+#define PHY_IRQ_CTRL_REG    MII_MICR
+#define PHY_IRQ_CTRL        0x0003U     /* INTEN | INT_OE.                  */
+#define PHY_IRQ_MASK_REG    0x12U       /* MISR.                            */
+#define PHY_IRQ_MASK        0x0024U     /* LINK_INT_EN | ANC_INT_EN.        */
+#define PHY_IRQ_STATUS_REG  0x12U
+#elif (BOARD_PHY_ID & 0xFFFFFF00U) == (MII_LAN8742A_ID & 0xFFFFFF00U)
+/* LAN87xx interrupt registers, the status register is cleared on read.*/
+#define PHY_IRQ_MASK_REG    0x1EU       /* Interrupt mask register.         */
+#define PHY_IRQ_MASK        0x0050U     /* Link down | AN complete.         */
+#define PHY_IRQ_STATUS_REG  0x1DU       /* Interrupt source register.       */
+#else
+#error "STM32_MAC_PHY_INTERRUPT not supported by the board PHY"
+#endif
+#endif
+
+/* Descriptor pointed by a tail pointer register value.*/
+#define TDES_FROM_TAIL(tp)  ((stm32_eth_tx_descriptor_t *)((uint32_t)&__eth_td[0] + (tp)))
+
+/* Buffers in the TCM memories are not accessible by the Ethernet DMA.*/
+#if defined(STM32H7XX)
+#define IS_DMA_BUFFER(p)    ((((uint32_t)(p) & 0xFFFF0000U) != 0x00000000U) && \
+                             (((uint32_t)(p) & 0xFFFE0000U) != 0x20000000U))
+#else
+#define IS_DMA_BUFFER(p)    true
+#endif
 
 /* Fixing inconsistencies in ST headers.*/
 #if !defined(ETH_MACMDIOAR_CR_Div124) && defined(ETH_MACMDIOAR_CR_DIV124)
@@ -129,10 +188,61 @@ static stm32_eth_rx_descriptor_t __eth_rd[STM32_MAC_RECEIVE_BUFFERS]
 static stm32_eth_tx_descriptor_t __eth_td[STM32_MAC_TRANSMIT_BUFFERS]
                         __attribute__((aligned(4), __section__(".eth")));
 
-static uint32_t __eth_rb[STM32_MAC_RECEIVE_BUFFERS][BUFFER_SIZE]
-                        __attribute__((aligned(4), __section__(".eth")));
-static uint32_t __eth_tb[STM32_MAC_TRANSMIT_BUFFERS][BUFFER_SIZE]
-                        __attribute__((aligned(4), __section__(".eth")));
+static uint32_t __eth_rb[STM32_MAC_RECEIVE_BUFFERS][RX_BUFFER_SIZE] BUFFER_ATTR;
+static uint32_t __eth_tb[STM32_MAC_TRANSMIT_BUFFERS][BUFFER_SIZE] BUFFER_ATTR;
+
+#if MAC_USE_SCATTER_GATHER || defined(__DOXYGEN__)
+/* Scatter-gather state of the transmit descriptors, the cookie is kept by
+   the last descriptor of a frame.*/
+static struct {
+  bool                  busy;
+  void                  *cookie;
+} __eth_tsg[STM32_MAC_TRANSMIT_BUFFERS];
+
+/* Cookies of the transmitted frames not yet reclaimed.*/
+static struct {
+  void                  *cookie;
+  mactimestamp_t        ts;
+} __eth_tdone[STM32_MAC_TRANSMIT_COOKIES];
+static unsigned __eth_tdone_rd, __eth_tdone_cnt;
+
+/* Cookies not yet reclaimed, frames in flight included. The bound on this
+   count keeps __eth_tdone from overflowing when the ring is refilled faster
+   than the cookies are reclaimed, it is independent of the ring size.*/
+static unsigned __eth_tcookies;
+#endif
+
+#if MAC_USE_STATISTICS || defined(__DOXYGEN__)
+/* Accumulated hardware counters.*/
+static macstatistics_t __eth_stats;
+#endif
+
+#if MAC_USE_RING_STATISTICS || defined(__DOXYGEN__)
+/* Descriptor rings occupancy.*/
+static macringstatistics_t __eth_rings;
+
+/* Receive descriptors held by the upper layer and transmit descriptors
+   locked by the driver, updated when their ownership changes.*/
+static unsigned __eth_rxheld, __eth_txlocked;
+#endif
+
+#if MAC_USE_FILTERS || defined(__DOXYGEN__)
+/* The filters state is retained across restarts, it must not be named
+   after the __eth_ prefix that places the variables in the non-zeroed
+   .eth section.*/
+
+/* Multicast addresses in the MACA1..MACA3 perfect filter slots.*/
+static struct {
+  uint8_t               addr[6];
+  uint8_t               refs;
+} filter_mcslot[3];
+
+/* References to the 64 bins of the hash filter.*/
+static uint8_t filter_hashrefs[64];
+
+/* Current filter mode.*/
+static macfiltermode_t filter_mode;
+#endif
 
 /*===========================================================================*/
 /* Driver local functions.                                                   */
@@ -231,6 +341,236 @@ static void mac_lld_set_address(const uint8_t *p) {
   ETH->MACHT1R   = 0;
 }
 
+#if MAC_USE_FILTERS || defined(__DOXYGEN__)
+/**
+ * @brief   Hash filter bin of an address.
+ * @details Upper 6 bits of the bit-reversed Ethernet CRC of the address.
+ *
+ * @param[in] addr      pointer to a six bytes address
+ * @return              The bin index.
+ */
+static unsigned mac_lld_hash_bin(const uint8_t *addr) {
+  uint32_t crc = 0xFFFFFFFFU;
+  unsigned i, j;
+
+  for (i = 0U; i < 6U; i++) {
+    crc ^= addr[i];
+    for (j = 0U; j < 8U; j++) {
+      crc = (crc >> 1) ^ ((crc & 1U) != 0U ? 0xEDB88320U : 0U);
+    }
+  }
+
+  return (unsigned)(__RBIT(~crc) >> 26);
+}
+
+/**
+ * @brief   Writes the filter state into the MAC registers.
+ */
+static void mac_lld_update_filters(void) {
+  volatile uint32_t *slotp = &ETH->MACA1HR;
+  uint32_t ht[2] = {0U, 0U};
+  uint32_t pfr;
+  unsigned i;
+
+  for (i = 0U; i < 3U; i++, slotp += 2) {
+    const uint8_t *p = filter_mcslot[i].addr;
+
+    if (filter_mcslot[i].refs > 0U) {
+      slotp[1] = ((uint32_t)p[3] << 24) |
+                 ((uint32_t)p[2] << 16) |
+                 ((uint32_t)p[1] << 8) |
+                 ((uint32_t)p[0] << 0);
+      slotp[0] = ETH_MACA1HR_AE |
+                 ((uint32_t)p[5] << 8) |
+                 ((uint32_t)p[4] << 0);
+    }
+    else {
+      slotp[0] = 0U;
+      slotp[1] = 0U;
+    }
+  }
+
+  for (i = 0U; i < 64U; i++) {
+    if (filter_hashrefs[i] > 0U) {
+      ht[i >> 5] |= 1U << (i & 31U);
+    }
+  }
+  ETH->MACHT0R = ht[0];
+  ETH->MACHT1R = ht[1];
+
+  /* Multicast frames pass if matching either a perfect filter slot or a
+     hash bin, unicast frames only the perfect filter.*/
+  switch (filter_mode) {
+  case MAC_FILTER_PROMISCUOUS:
+    pfr = ETH_MACPFR_PR;
+    break;
+  case MAC_FILTER_ALL_MULTICAST:
+    pfr = ETH_MACPFR_PM;
+    break;
+  default:
+    pfr = ETH_MACPFR_HPF | ETH_MACPFR_HMC;
+    break;
+  }
+  ETH->MACPFR = pfr | MACPFR_PCF;
+}
+#endif
+
+/**
+ * @brief   Locates the data at the current offset of a received frame.
+ *
+ * @param[in] rdp       pointer to a @p MACReceiveDescriptor structure
+ * @param[out] sizep    pointer to variable receiving the number of bytes
+ *                      available in the same buffer
+ * @return              Pointer to the data at the current offset.
+ */
+static const uint8_t *mac_lld_rdes_chunk(MACReceiveDescriptor *rdp,
+                                         size_t *sizep) {
+  stm32_eth_rx_descriptor_t *rdes = rdp->physdesc;
+  size_t i, n;
+
+  for (i = rdp->offset / STM32_MAC_RX_BUFFERS_SIZE; i > 0U; i--) {
+    rdes = RDES_NEXT(rdes);
+  }
+  i = rdp->offset % STM32_MAC_RX_BUFFERS_SIZE;
+  n = STM32_MAC_RX_BUFFERS_SIZE - i;
+  if (n > rdp->size - rdp->offset)
+    n = rdp->size - rdp->offset;
+  *sizep = n;
+
+  return RDES_BUFFER(rdes) + i;
+}
+
+/**
+ * @brief   Gives a receive descriptor back to the DMA.
+ *
+ * @param[in] rdes      pointer to the physical receive descriptor
+ */
+static void mac_lld_rdes_to_dma(stm32_eth_rx_descriptor_t *rdes) {
+
+#if STM32_MAC_BUFFERS_CACHED
+  /* Lines modified by the upper layer are discarded, a later eviction
+     would overwrite the data written by the DMA.*/
+  cacheBufferInvalidate(RDES_BUFFER(rdes), RX_BUFFER_SIZE * 4U);
+#endif
+  rdes->rdes0 = (uint32_t)RDES_BUFFER(rdes);
+  rdes->rdes2 = 0U;
+#if STM32_MAC_RX_COALESCING
+  /* Only one descriptor every threshold raises an interrupt, the watchdog
+     takes care of the others.*/
+  if (((unsigned)(rdes - &__eth_rd[0]) % STM32_MAC_RX_FRAMES_THRESHOLD) ==
+      (STM32_MAC_RX_FRAMES_THRESHOLD - 1U)) {
+    rdes->rdes3 = STM32_RDES3_OWN | STM32_RDES3_IOC | STM32_RDES3_BUF1V;
+  }
+  else {
+    rdes->rdes3 = STM32_RDES3_OWN | STM32_RDES3_BUF1V;
+  }
+#else
+  rdes->rdes3 = STM32_RDES3_OWN | STM32_RDES3_IOC | STM32_RDES3_BUF1V;
+#endif
+}
+
+#if MAC_USE_SCATTER_GATHER || defined(__DOXYGEN__)
+/**
+ * @brief   Frees the descriptors of the transmitted scatter-gather frames.
+ * @details The descriptors are made available immediately, the cookies
+ *          are queued until reclaimed.
+ */
+static void mac_lld_collect_transmitted(void) {
+  unsigned i;
+
+  for (i = 0U; i < STM32_MAC_TRANSMIT_BUFFERS; i++) {
+    if (__eth_tsg[i].busy && ((__eth_td[i].tdes3 & STM32_TDES3_OWN) == 0U)) {
+      if (__eth_tsg[i].cookie != NULL) {
+        unsigned j = (__eth_tdone_rd + __eth_tdone_cnt) %
+                     STM32_MAC_TRANSMIT_COOKIES;
+
+        __eth_tdone[j].cookie  = __eth_tsg[i].cookie;
+        __eth_tdone[j].ts.nsec = MAC_TIMESTAMP_INVALID;
+#if MAC_USE_TIMESTAMPS
+        /* The last descriptor of the frame has been written back with the
+           transmission timestamp.*/
+        if ((__eth_td[i].tdes3 & STM32_TDES3_TTSS) != 0U) {
+          __eth_tdone[j].ts.sec  = __eth_td[i].tdes1;
+          __eth_tdone[j].ts.nsec = __eth_td[i].tdes0;
+        }
+#endif
+        __eth_tdone_cnt++;
+        __eth_tsg[i].cookie = NULL;
+      }
+      __eth_tsg[i].busy = false;
+      __eth_td[i].tdes1 = 0U;
+    }
+  }
+}
+#endif
+
+#if MAC_USE_STATISTICS || defined(__DOXYGEN__)
+/**
+ * @brief   Accumulates the receive drop counters.
+ * @details These counters are only 11 bits wide and cleared on read, they
+ *          are collected on each receive interrupt.
+ */
+static void mac_lld_collect_drops(void) {
+  uint32_t mfcr, mpocr;
+
+  mfcr  = ETH->DMACMFCR;
+  mpocr = ETH->MTLRQMPOCR;
+  __eth_stats.rx_missed_frames  += (mfcr & ETH_DMACMFCR_MFC) >>
+                                   ETH_DMACMFCR_MFC_Pos;
+  __eth_stats.rx_fifo_overflows += (mpocr & ETH_MTLRQMPOCR_OVFPKTCNT) >>
+                                   ETH_MTLRQMPOCR_OVFPKTCNT_Pos;
+  if (((mfcr & ETH_DMACMFCR_MFCO) != 0U) ||
+      ((mpocr & ETH_MTLRQMPOCR_OVFCNTOVF) != 0U)) {
+    __eth_stats.overflow = true;
+  }
+}
+#endif
+
+#if MAC_USE_RING_STATISTICS || defined(__DOXYGEN__)
+/**
+ * @brief   Samples the occupancy of the descriptor rings.
+ * @details Receive descriptors are in use if held by the upper layer or
+ *          written by the DMA and not yet taken, transmit descriptors are
+ *          in use if locked or owned by the DMA. The descriptors owned by
+ *          the DMA are counted from the distance between its current
+ *          descriptor and the tail pointer, the rings are not scanned.
+ */
+static void mac_lld_sample_rings(void) {
+  stm32_eth_rx_descriptor_t *rdtail;
+  unsigned rdcur, tdcur, tdtail, rxpending, txpending;
+
+  /* Frames written by the DMA wait between the tail pointer, where they
+     are taken, and the current descriptor of the DMA. The DMA stops on
+     the tail pointer when the ring is full.*/
+  rdtail = (stm32_eth_rx_descriptor_t *)((uint32_t)&__eth_rd[0] +
+                                         ETH->DMACRDTPR);
+  rdcur  = (unsigned)((ETH->DMACCARDR - (uint32_t)&__eth_rd[0]) /
+                      sizeof (stm32_eth_rx_descriptor_t));
+  rxpending = (rdcur + STM32_MAC_RECEIVE_BUFFERS -
+               (unsigned)(rdtail - &__eth_rd[0])) % STM32_MAC_RECEIVE_BUFFERS;
+  if ((rxpending == 0U) &&
+      ((rdtail->rdes3 & STM32_RDES3_OWN) == 0U) &&
+      ((rdtail->rdes2 & STM32_RDES2_LOCKED) == 0U)) {
+    rxpending = STM32_MAC_RECEIVE_BUFFERS - __eth_rxheld;
+  }
+
+  /* Descriptors given to the DMA and not yet processed are between its
+     current descriptor and the tail pointer.*/
+  tdtail = (unsigned)(ETH->DMACTDTPR / sizeof (stm32_eth_tx_descriptor_t));
+  tdcur  = (unsigned)((ETH->DMACCATDR - (uint32_t)&__eth_td[0]) /
+                      sizeof (stm32_eth_tx_descriptor_t));
+  txpending = (tdtail + STM32_MAC_TRANSMIT_BUFFERS - tdcur) %
+              STM32_MAC_TRANSMIT_BUFFERS;
+  if ((txpending == 0U) && (tdcur < STM32_MAC_TRANSMIT_BUFFERS) &&
+      ((__eth_td[tdcur].tdes3 & STM32_TDES3_OWN) != 0U)) {
+    txpending = STM32_MAC_TRANSMIT_BUFFERS;
+  }
+
+  macOccupancySampleX(&__eth_rings.rx, __eth_rxheld + rxpending);
+  macOccupancySampleX(&__eth_rings.tx, __eth_txlocked + txpending);
+}
+#endif
+
 /*===========================================================================*/
 /* Driver interrupt handlers.                                                */
 /*===========================================================================*/
@@ -247,14 +587,40 @@ OSAL_IRQ_HANDLER(STM32_ETH_HANDLER) {
   if ((dmacsr & (ETH_DMACSR_RI | ETH_DMACSR_TI)) != 0U) {
     if ((dmacsr & ETH_DMACSR_TI) != 0U) {
       /* Data Transmitted.*/
+#if MAC_USE_SCATTER_GATHER
+      osalSysLockFromISR();
+      mac_lld_collect_transmitted();
+      osalSysUnlockFromISR();
+#endif
       __mac_tx_wakeup(macp);
     }
 
     if ((dmacsr & ETH_DMACSR_RI) != 0U) {
       /* Data Received.*/
+      macp->rxirqs++;
+#if STM32_MAC_FLOW_CONTROL
+      if ((ETH->MTLRQDR & ETH_MTLRQDR_RXQSTS_ABOVETHRESHOLD) != 0U) {
+        macp->rxfcevents++;
+      }
+#endif
+#if MAC_USE_STATISTICS
+      osalSysLockFromISR();
+      mac_lld_collect_drops();
+      osalSysUnlockFromISR();
+#endif
+#if STM32_MAC_RX_COALESCING
+      /* The receive interrupt stays masked until the ring is drained.*/
+      ETH->DMACIER &= ~ETH_DMACIER_RIE;
+#endif
       __mac_rx_wakeup(macp);
     }
 
+#if MAC_USE_RING_STATISTICS
+    osalSysLockFromISR();
+    mac_lld_sample_rings();
+    osalSysUnlockFromISR();
+#endif
+
     __mac_callback(macp);
   }
 
@@ -279,10 +645,8 @@ void mac_lld_init(void) {
   /* Descriptor tables are initialized in ring mode, note that the first
      word is not initialized here but in mac_lld_start().*/
   for (i = 0; i < STM32_MAC_RECEIVE_BUFFERS; i++) {
-    __eth_rd[i].rdes0 = (uint32_t)__eth_rb[i];
     __eth_rd[i].rdes1 = 0;
-    __eth_rd[i].rdes2 = 0;
-    __eth_rd[i].rdes3 = STM32_RDES3_OWN | STM32_RDES3_IOC | STM32_RDES3_BUF1V;
+    mac_lld_rdes_to_dma(&__eth_rd[i]);
   }
   for (i = 0; i < STM32_MAC_TRANSMIT_BUFFERS; i++) {
     __eth_td[i].tdes0 = 0;
@@ -361,11 +725,31 @@ void mac_lld_start(MACDriver *macp) {
 
   /* Resets the state of all descriptors.*/
   for (i = 0; i < STM32_MAC_RECEIVE_BUFFERS; i++) {
-    __eth_rd[i].rdes3 = STM32_RDES3_OWN | STM32_RDES3_IOC | STM32_RDES3_BUF1V;
+    mac_lld_rdes_to_dma(&__eth_rd[i]);
   }
   for (i = 0; i < STM32_MAC_TRANSMIT_BUFFERS; i++) {
+    __eth_td[i].tdes1 = 0U;
     __eth_td[i].tdes3 = 0U;
+#if MAC_USE_SCATTER_GATHER
+    __eth_tsg[i].busy   = false;
+    __eth_tsg[i].cookie = NULL;
+#endif
   }
+#if MAC_USE_SCATTER_GATHER
+  __eth_tdone_rd  = 0U;
+  __eth_tdone_cnt = 0U;
+  __eth_tcookies  = 0U;
+#endif
+  macp->rxirqs     = 0U;
+  macp->rxframes   = 0U;
+  macp->rxcsumerrs = 0U;
+  macp->rxfcevents = 0U;
+#if MAC_USE_RING_STATISTICS
+  macOccupancyObjectInit(&__eth_rings.rx, STM32_MAC_RECEIVE_BUFFERS);
+  macOccupancyObjectInit(&__eth_rings.tx, STM32_MAC_TRANSMIT_BUFFERS);
+  __eth_rxheld   = 0U;
+  __eth_txlocked = 0U;
+#endif
 
   /* MAC clocks activation and commanded reset procedure.*/
   rccEnableETH(true);
@@ -378,13 +762,35 @@ void mac_lld_start(MACDriver *macp) {
   mii_write(macp, MII_BMCR, mii_read(macp, MII_BMCR) & ~BMCR_PDOWN);
 #endif
 
+#if STM32_MAC_PHY_INTERRUPT
+  /* PHY interrupt output enabled on link events, stale events cleared.*/
+#if defined(PHY_IRQ_CTRL_REG)
+  mii_write(macp, PHY_IRQ_CTRL_REG, PHY_IRQ_CTRL);
+#endif
+  mii_write(macp, PHY_IRQ_MASK_REG, PHY_IRQ_MASK);
+  (void)mii_read(macp, PHY_IRQ_STATUS_REG);
+#endif
+
+#if STM32_MAC_FLOW_CONTROL && (STM32_MAC_PHY_LINK_TYPE == MAC_LINK_DYNAMIC)
+  /* Pause capability advertised, the negotiation is restarted if it was
+     not already advertised.*/
+  {
+    uint32_t anar = mii_read(macp, MII_ADVERTISE);
+
+    if ((anar & ADVERTISE_PAUSE_CAP) == 0U) {
+      mii_write(macp, MII_ADVERTISE, anar | ADVERTISE_PAUSE_CAP);
+      mii_write(macp, MII_BMCR, mii_read(macp, MII_BMCR) | BMCR_ANRESTART);
+    }
+  }
+#endif
+
   ETH->DMAMR |= ETH_DMAMR_SWR;
   while (ETH->DMAMR & ETH_DMAMR_SWR)
     ;
 
   /* MAC configuration.*/
   ETH->MACCR   = ETH_MACCR_DO;
-  ETH->MACPFR  = 0U;
+  ETH->MACPFR  = MACPFR_PCF;
   ETH->MACTFCR = 0U;
   ETH->MACRFCR = 0U;
   ETH->MACVTR  = 0U;
@@ -395,6 +801,11 @@ void mac_lld_start(MACDriver *macp) {
   else
     mac_lld_set_address(macp->config->mac_address);
 
+#if MAC_USE_FILTERS
+  /* Restoring the receive filters, they are retained across restarts.*/
+  mac_lld_update_filters();
+#endif
+
   /* Transmitter and receiver enabled.
      Note that the complete setup of the MAC is performed when the link
      status is detected.*/
@@ -404,6 +815,36 @@ void mac_lld_start(MACDriver *macp) {
   ETH->MACCR |=                 ETH_MACCR_RE | ETH_MACCR_TE;
 #endif
 
+#if MAC_USE_STATISTICS
+  /* Counters reset, then cleared on each read so they can be accumulated
+     in 64 bits.*/
+  ETH->MMCCR     = ETH_MMCCR_CNTRST;
+  ETH->MMCCR     = ETH_MMCCR_RSTONRD;
+  (void)ETH->DMACMFCR;
+  (void)ETH->MTLRQMPOCR;
+  memset(&__eth_stats, 0, sizeof (__eth_stats));
+#endif
+
+#if MAC_USE_TIMESTAMPS
+  /* Timestamping clock in fine update mode, the addend divides HCLK down
+     to STM32_MAC_PTP_FREQUENCY and the sub-second increment is the period
+     of that frequency in nanoseconds. All received frames are stamped.*/
+  ETH->MACTSCR   = ETH_MACTSCR_TSENA | ETH_MACTSCR_TSENALL |
+                   ETH_MACTSCR_TSCTRLSSR | ETH_MACTSCR_TSCFUPDT;
+  ETH->MACSSIR   = (1000000000U / STM32_MAC_PTP_FREQUENCY) <<
+                   ETH_MACMACSSIR_SSINC_Pos;
+  ETH->MACTSAR   = (uint32_t)(((uint64_t)STM32_MAC_PTP_FREQUENCY << 32) /
+                              STM32_HCLK);
+  ETH->MACTSCR  |= ETH_MACTSCR_TSADDREG;
+  while ((ETH->MACTSCR & ETH_MACTSCR_TSADDREG) != 0U)
+    ;
+  ETH->MACSTSUR  = 0U;
+  ETH->MACSTNUR  = 0U;
+  ETH->MACTSCR  |= ETH_MACTSCR_TSINIT;
+  while ((ETH->MACTSCR & ETH_MACTSCR_TSINIT) != 0U)
+    ;
+#endif
+
   /* MMC configuration:
      Disable all interrupts.*/
   ETH->MMCTIMR   = (1<<27) | (1<<26) | (1<<21) | (1<<15) | (1<<14);
@@ -424,6 +865,9 @@ void mac_lld_start(MACDriver *macp) {
   /* Enabling required interrupt sources.*/
   ETH->DMACSR    = ETH_DMACSR_NIS;
   ETH->DMACIER   = ETH_DMACIER_NIE | ETH_DMACIER_RIE | ETH_DMACIER_TIE;
+#if STM32_MAC_RX_COALESCING
+  ETH->DMACRIWTR = STM32_MAC_RX_WATCHDOG;
+#endif
 
   /* Check because errata on some devices. There should be no need to
      disable flushing because the TXFIFO should be empty on macStart().*/
@@ -435,11 +879,11 @@ void mac_lld_start(MACDriver *macp) {
 #endif
 
   /* DMA final configuration and start.*/
-  ETH->MTLRQOMR  = ETH_MTLRQOMR_DISTCPEF | ETH_MTLRQOMR_RSF;
+  ETH->MTLRQOMR  = ETH_MTLRQOMR_DISTCPEF | ETH_MTLRQOMR_RSF | MTLRQOMR_FC;
   ETH->MTLTQOMR  = ETH_MTLTQOMR_TSF;
   ETH->DMACTCR   = ETH_DMACTCR_ST | ETH_DMACTCR_TPBL_1PBL;
   ETH->DMACRCR   = ETH_DMACRCR_SR | ETH_DMACRCR_RPBL_1PBL |
-                   (STM32_MAC_BUFFERS_SIZE << ETH_DMACRCR_RBSZ_Pos);
+                   (STM32_MAC_RX_BUFFERS_SIZE << ETH_DMACRCR_RBSZ_Pos);
 }
 
 /**
@@ -492,8 +936,17 @@ msg_t mac_lld_get_transmit_descriptor(MACDriver *macp,
   if (!macp->link_up)
     return MSG_TIMEOUT;
 
+#if MAC_USE_SCATTER_GATHER
+  /* Descriptors of transmitted scatter-gather frames are made available.*/
+  mac_lld_collect_transmitted();
+#endif
+
+#if MAC_USE_RING_STATISTICS
+  mac_lld_sample_rings();
+#endif
+
   /* Scanning for all descriptors ahead of the current tail pointer.*/
-  current_tdes = (stm32_eth_tx_descriptor_t *)((uint32_t)&__eth_td[0] + ETH->DMACTDTPR);
+  current_tdes = TDES_FROM_TAIL(ETH->DMACTDTPR);
   for (i = 0U; i < STM32_MAC_TRANSMIT_BUFFERS; i++) {
 
     /* Skipping descriptors that are locked and already owned by the DMA.*/
@@ -503,6 +956,9 @@ msg_t mac_lld_get_transmit_descriptor(MACDriver *macp,
       /* Assigning the buffer and marking the descriptor as locked.*/
       current_tdes->tdes0 = (uint32_t)__eth_tb[current_tdes - &__eth_td[0]];
       current_tdes->tdes1 = STM32_TDES1_LOCKED;
+#if MAC_USE_RING_STATISTICS
+      __eth_txlocked++;
+#endif
 
       /* Set the buffer size and configuration.*/
       tdp->offset   = 0U;
@@ -536,7 +992,15 @@ void mac_lld_release_transmit_descriptor(MACTransmitDescriptor *tdp) {
   osalDbgAssert((tdes->tdes3 & STM32_TDES3_OWN) == 0U,
               "attempt to release descriptor already owned by DMA");
 
+#if STM32_MAC_BUFFERS_CACHED
+  /* Frame data must be in RAM before the DMA reads it.*/
+  cacheBufferFlush(tdes->tdes0, tdp->offset);
+#endif
+
   /* Give buffer back to the Ethernet DMA.*/
+#if MAC_USE_RING_STATISTICS
+  __eth_txlocked--;
+#endif
   tdes->tdes1 = 0U;
   tdes->tdes2 = STM32_TDES2_IOC | (tdp->offset & STM32_TDES2_B1L_MASK);
 #if STM32_MAC_IP_CHECKSUM_OFFLOAD
@@ -575,51 +1039,127 @@ msg_t mac_lld_get_receive_descriptor(MACDriver *macp,
   stm32_eth_rx_descriptor_t *current_rdes;
   unsigned i;
 
-  (void)macp;
+#if MAC_USE_RING_STATISTICS
+  mac_lld_sample_rings();
+#endif
 
   /* Scanning for all descriptors ahead of the current tail pointer.*/
   current_rdes = (stm32_eth_rx_descriptor_t *)((uint32_t)&__eth_rd[0] + ETH->DMACRDTPR);
-  for (i = 0U; i < STM32_MAC_RECEIVE_BUFFERS; i++) {
-    stm32_eth_rx_descriptor_t *next_rdes;
+  i = 0U;
+  while (i < STM32_MAC_RECEIVE_BUFFERS) {
+    stm32_eth_rx_descriptor_t *last_rdes, *next_rdes, *rdes;
+    unsigned ndesc;
+
+    /* Is the descriptor owned by DMA?*/
+    if ((current_rdes->rdes3 & STM32_RDES3_OWN) != 0U) {
+      break;
+    }
 
-    /* Pointing on the next descriptor.*/
-    next_rdes = current_rdes + 1;
-    if (next_rdes >= &__eth_rd[STM32_MAC_RECEIVE_BUFFERS]) {
-      next_rdes = &__eth_rd[0];
+    /* Descriptors still held by the upper layer, the ring wrapped around
+       and there is nothing new to process.*/
+    if ((current_rdes->rdes2 & STM32_RDES2_LOCKED) != 0U) {
+      break;
+    }
+
+    /* Descriptors not starting a frame are returned to DMA without
+       processing, this covers orphan context descriptors and the tails
+       of discarded frames.*/
+    if ((current_rdes->rdes3 & (STM32_RDES3_CTXT | STM32_RDES3_FD)) !=
+        STM32_RDES3_FD) {
+      mac_lld_rdes_to_dma(current_rdes);
+      current_rdes = RDES_NEXT(current_rdes);
+      i++;
+      continue;
     }
 
-    /* Is the descriptor not owned by DMA?*/
-    if ((current_rdes->rdes3 & STM32_RDES3_OWN) == 0U) {
+    /* Looking for the last descriptor of the frame, the frame can span
+       multiple descriptors if it is larger than a receive buffer.*/
+    last_rdes = current_rdes;
+    ndesc = 1U;
+    while ((last_rdes->rdes3 & STM32_RDES3_LD) == 0U) {
+      next_rdes = RDES_NEXT(last_rdes);
+      if ((next_rdes->rdes3 & STM32_RDES3_OWN) != 0U) {
+        /* Frame reception still in progress.*/
+        goto incomplete;
+      }
+      if (((next_rdes->rdes3 & (STM32_RDES3_CTXT | STM32_RDES3_FD)) != 0U) ||
+          ((next_rdes->rdes2 & STM32_RDES2_LOCKED) != 0U)) {
+        /* Truncated frame, it is discarded.*/
+        break;
+      }
+      last_rdes = next_rdes;
+      ndesc++;
+    }
+    next_rdes = RDES_NEXT(last_rdes);
 
-      /* Yes, checking if it is a frame to be processed.*/
-      uint32_t rdes3 = current_rdes->rdes3 & (STM32_RDES3_ES |
-                                              STM32_RDES3_FD |
-                                              STM32_RDES3_LD);
-      if ((rdes3 == (STM32_RDES3_FD | STM32_RDES3_LD)) &&
+    /* Yes, checking if it is a frame to be processed.*/
+    uint32_t rdes3 = last_rdes->rdes3 & (STM32_RDES3_ES | STM32_RDES3_LD);
 #if STM32_MAC_IP_CHECKSUM_OFFLOAD
-          ((current_rdes->rdes1 & (STM32_RDES1_IPHE | STM32_RDES1_IPCE)) == 0U) &&
+    /* Header and payload checksums are not verified in software, frames
+       failing the hardware check are dropped here.*/
+    if ((rdes3 == STM32_RDES3_LD) &&
+        ((last_rdes->rdes3 & STM32_RDES3_RS1V) != 0U) &&
+        ((last_rdes->rdes1 & (STM32_RDES1_IPHE | STM32_RDES1_IPCE)) != 0U)) {
+      macp->rxcsumerrs++;
+      rdes3 = STM32_RDES3_ES;
+    }
 #endif
-          ((current_rdes->rdes2 & STM32_RDES2_DAF) == 0U)) {
-
-        /* Found a valid one.*/
-        rdp->offset   = 0U;
-        rdp->size     = (current_rdes->rdes3 & STM32_RDES3_PL_MASK) -2; /* Lose CRC.*/
-        rdp->physdesc = current_rdes;
-
-        /* Moving the tail pointer, this also wakes the DMA up.*/
-        ETH->DMACRDTPR = (uint32_t)next_rdes - (uint32_t)&__eth_rd[0];
-
-        return MSG_OK;
+    if ((rdes3 == STM32_RDES3_LD) &&
+        ((last_rdes->rdes2 & STM32_RDES2_DAF) == 0U)) {
+
+      /* Found a valid one, it is locked until released.*/
+      macp->rxframes++;
+      rdp->offset   = 0U;
+      rdp->size     = (last_rdes->rdes3 & STM32_RDES3_PL_MASK) -2; /* Lose CRC.*/
+      rdp->physdesc = current_rdes;
+      rdp->ndesc    = ndesc;
+#if MAC_USE_RING_STATISTICS
+      __eth_rxheld += ndesc;
+#endif
+      for (rdes = current_rdes; ndesc > 0U; ndesc--, rdes = RDES_NEXT(rdes)) {
+        rdes->rdes2 |= STM32_RDES2_LOCKED;
+#if STM32_MAC_BUFFERS_CACHED
+        /* Lines speculatively loaded while the DMA was writing are
+           discarded before the frame is accessed.*/
+        cacheBufferInvalidate(RDES_BUFFER(rdes), RX_BUFFER_SIZE * 4U);
+#endif
+      }
+#if MAC_USE_TIMESTAMPS
+      /* The timestamp, if any, is in the context descriptor following
+         the frame, the context descriptor is given back immediately.*/
+      rdp->ts.nsec  = MAC_TIMESTAMP_INVALID;
+      if (((last_rdes->rdes3 & STM32_RDES3_RS1V) != 0U) &&
+          ((last_rdes->rdes1 & STM32_RDES1_TSA) != 0U) &&
+          ((next_rdes->rdes3 & (STM32_RDES3_OWN | STM32_RDES3_CTXT)) ==
+           STM32_RDES3_CTXT)) {
+        rdp->ts.sec  = next_rdes->rdes1;
+        rdp->ts.nsec = next_rdes->rdes0;
+        mac_lld_rdes_to_dma(next_rdes);
+        next_rdes = RDES_NEXT(next_rdes);
       }
+#endif
+
+      /* Moving the tail pointer, this also wakes the DMA up.*/
+      ETH->DMACRDTPR = (uint32_t)next_rdes - (uint32_t)&__eth_rd[0];
 
-      /* Other descriptor type, returning it to DMA without processing.*/
-      current_rdes->rdes3 = STM32_RDES3_OWN | STM32_RDES3_IOC | STM32_RDES3_BUF1V;
+      return MSG_OK;
+    }
 
-      /* Pointing on the next descriptor.*/
-      current_rdes = next_rdes;
+    /* Invalid frame, returning its descriptors to DMA.*/
+    i += ndesc;
+    for (; ndesc > 0U; ndesc--) {
+      mac_lld_rdes_to_dma(current_rdes);
+      current_rdes = RDES_NEXT(current_rdes);
     }
   }
 
+incomplete:
+#if STM32_MAC_RX_COALESCING
+  /* Nothing left to process, interrupts enabled again, frames received
+     in the meantime are still flagged in DMACSR.*/
+  ETH->DMACIER |= ETH_DMACIER_RIE;
+#endif
+
   return MSG_TIMEOUT;
 }
 
@@ -634,11 +1174,20 @@ msg_t mac_lld_get_receive_descriptor(MACDriver *macp,
  */
 void mac_lld_release_receive_descriptor(MACReceiveDescriptor *rdp) {
 
-  osalDbgAssert((rdp->physdesc->rdes3 & STM32_RDES3_OWN) == 0U,
-                "attempt to release descriptor already owned by DMA");
+  stm32_eth_rx_descriptor_t *rdes = rdp->physdesc;
+  unsigned i;
+
+  /* Give buffers back to the Ethernet DMA.*/
+#if MAC_USE_RING_STATISTICS
+  __eth_rxheld -= (unsigned)rdp->ndesc;
+#endif
+  for (i = 0U; i < rdp->ndesc; i++) {
+    osalDbgAssert((rdes->rdes3 & STM32_RDES3_OWN) == 0U,
+                  "attempt to release descriptor already owned by DMA");
 
-  /* Give buffer back to the Ethernet DMA.*/
-  rdp->physdesc->rdes3 = STM32_RDES3_OWN | STM32_RDES3_IOC | STM32_RDES3_BUF1V;
+    mac_lld_rdes_to_dma(rdes);
+    rdes = RDES_NEXT(rdes);
+  }
 
   /* Re-triggering the DMA, in case in case it went in suspend mode before
      a found frame was released and the ring is full.*/
@@ -658,9 +1207,17 @@ void mac_lld_release_receive_descriptor(MACReceiveDescriptor *rdp) {
 bool mac_lld_poll_link_status(MACDriver *macp) {
 #if STM32_MAC_PHY_LINK_TYPE == MAC_LINK_DYNAMIC
   uint32_t maccr, bmsr, bmcr;
+#if STM32_MAC_FLOW_CONTROL
+  uint32_t tfcr = 0U, rfcr = 0U;
+#endif
 
   maccr = ETH->MACCR;
 
+#if STM32_MAC_PHY_INTERRUPT
+  /* Acknowledging the PHY interrupt, the line is released.*/
+  (void)mii_read(macp, PHY_IRQ_STATUS_REG);
+#endif
+
   /* PHY CR and SR registers read.*/
   (void)mii_read(macp, MII_BMSR);
   bmsr = mii_read(macp, MII_BMSR);
@@ -689,6 +1246,14 @@ bool mac_lld_poll_link_status(MACDriver *macp) {
       maccr |= ETH_MACCR_DM;
     else
       maccr &= ~ETH_MACCR_DM;
+
+#if STM32_MAC_FLOW_CONTROL
+    /* Flow control if supported by the link partner, full duplex only.*/
+    if ((maccr & ETH_MACCR_DM) && (lpa & LPA_PAUSE_CAP)) {
+      tfcr = (STM32_MAC_PAUSE_TIME << ETH_MACTFCR_PT_Pos) | ETH_MACTFCR_TFE;
+      rfcr = ETH_MACRFCR_RFE;
+    }
+#endif
   }
   else {
     /* Link must be established.*/
@@ -708,6 +1273,11 @@ bool mac_lld_poll_link_status(MACDriver *macp) {
       maccr &= ~ETH_MACCR_DM;
   }
 
+#if STM32_MAC_FLOW_CONTROL
+  ETH->MACTFCR = tfcr;
+  ETH->MACRFCR = rfcr;
+#endif
+
 #elif STM32_MAC_PHY_LINK_TYPE == MAC_LINK_100_FULLDUPLEX
   uint32_t maccr = ETH->MACCR;
 
@@ -778,19 +1348,423 @@ size_t mac_lld_read_receive_descriptor(MACReceiveDescriptor *rdp,
                                        uint8_t *buf,
                                        size_t size) {
 
+  const uint8_t *p;
+  size_t n, done;
+
   osalDbgAssert(!(rdp->physdesc->rdes3 & STM32_RDES3_OWN),
               "attempt to read descriptor already owned by DMA");
 
   if (size > rdp->size - rdp->offset)
     size = rdp->size - rdp->offset;
 
-  if (size > 0) {
-    memcpy(buf, (uint8_t *)(rdp->physdesc->rdes0) + rdp->offset, size);
-    rdp->offset += size;
+  /* The frame can be spread over multiple buffers.*/
+  for (done = 0U; done < size; done += n) {
+    p = mac_lld_rdes_chunk(rdp, &n);
+    if (n > size - done)
+      n = size - done;
+    memcpy(buf + done, p, n);
+    rdp->offset += n;
   }
   return size;
 }
 
+#if MAC_USE_SCATTER_GATHER || defined(__DOXYGEN__)
+/**
+ * @brief   Enqueues a frame composed of multiple buffers for transmission.
+ * @details The frame is linked across consecutive descriptors, two buffers
+ *          per descriptor, starting from the current tail pointer.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] bp        pointer to an array of @p macbuffer_t structures
+ * @param[in] n         number of buffers in the array
+ * @param[in] cookie    frame identifier
+ * @return              The operation status.
+ * @retval MSG_OK       the frame has been enqueued.
+ * @retval MSG_TIMEOUT  not enough descriptors available or too many
+ *                      transmitted frames not yet reclaimed.
+ * @retval MSG_RESET    the buffers are not accessible by the DMA or the
+ *                      frame does not fit the descriptors ring.
+ *
+ * @notapi
+ */
+msg_t mac_lld_transmit_buffers(MACDriver *macp, const macbuffer_t *bp,
+                               size_t n, void *cookie) {
+  stm32_eth_tx_descriptor_t *first_tdes, *tdes;
+  unsigned i, ndesc;
+  uint32_t first_tdes3 = 0U, tdes3_fd;
+  size_t fl;
+
+  if (!macp->link_up)
+    return MSG_TIMEOUT;
+
+  for (i = 0U, fl = 0U; i < n; i++) {
+    if (!IS_DMA_BUFFER(bp[i].buf))
+      return MSG_RESET;
+    fl += bp[i].size;
+  }
+
+  /* Control fields of the first descriptor of the frame.*/
+  tdes3_fd = STM32_TDES3_FD | (fl & STM32_TDES3_FL);
+#if STM32_MAC_IP_CHECKSUM_OFFLOAD
+  tdes3_fd |= STM32_TDES3_CIC(STM32_MAC_IP_CHECKSUM_OFFLOAD);
+#endif
+
+  /* Making sure that descriptors of already transmitted frames are
+     available.*/
+  mac_lld_collect_transmitted();
+
+#if MAC_USE_RING_STATISTICS
+  mac_lld_sample_rings();
+#endif
+
+  /* There must be room for the cookie of the frame among the transmitted
+     ones, until the older cookies are reclaimed.*/
+  if (__eth_tcookies >= STM32_MAC_TRANSMIT_COOKIES)
+    return MSG_TIMEOUT;
+
+  /* The frame requires consecutive free descriptors starting from the
+     current tail pointer, one descriptor of the ring is always left free
+     or the DMA would not see the new tail pointer.*/
+  ndesc = (unsigned)((n + 1U) / 2U);
+  if (ndesc > STM32_MAC_TRANSMIT_BUFFERS - 1U)
+    return MSG_RESET;
+  first_tdes = TDES_FROM_TAIL(ETH->DMACTDTPR);
+  tdes = first_tdes;
+  for (i = 0U; i < ndesc; i++) {
+    if (((tdes->tdes3 & STM32_TDES3_OWN) != 0U) || (tdes->tdes1 != 0U))
+      return MSG_TIMEOUT;
+    if (++tdes >= &__eth_td[STM32_MAC_TRANSMIT_BUFFERS])
+      tdes = &__eth_td[0];
+  }
+
+  /* Filling the descriptors, the ownership of the first one is given to
+     the DMA last.*/
+  tdes = first_tdes;
+  for (i = 0U; i < ndesc; i++, bp += 2, n -= 2U) {
+    unsigned idx = (unsigned)(tdes - &__eth_td[0]);
+    uint32_t tdes2, tdes3;
+
+    /* Data must be in RAM before the DMA reads it, the cache operation is
+       performed on whole lines.*/
+    cacheBufferFlush((uint32_t)bp[0].buf & ~(CACHE_LINE_SIZE - 1U),
+                     bp[0].size + ((uint32_t)bp[0].buf & (CACHE_LINE_SIZE - 1U)));
+    tdes->tdes0 = (uint32_t)bp[0].buf;
+    tdes2 = bp[0].size & STM32_TDES2_B1L_MASK;
+    if (n > 1U) {
+      cacheBufferFlush((uint32_t)bp[1].buf & ~(CACHE_LINE_SIZE - 1U),
+                       bp[1].size + ((uint32_t)bp[1].buf & (CACHE_LINE_SIZE - 1U)));
+      tdes->tdes1 = (uint32_t)bp[1].buf;
+      tdes2 |= (bp[1].size << 16) & STM32_TDES2_B2L_MASK;
+    }
+    else {
+      /* Buffer 2 is ignored by the DMA when its size is zero.*/
+      tdes->tdes1 = STM32_TDES1_LOCKED;
+    }
+
+    tdes3 = STM32_TDES3_OWN;
+    if (i == 0U) {
+#if MAC_USE_TIMESTAMPS
+      tdes2 |= STM32_TDES2_TTSE;
+#endif
+      tdes3 |= tdes3_fd;
+    }
+    if (i == ndesc - 1U) {
+      tdes2 |= STM32_TDES2_IOC;
+      tdes3 |= STM32_TDES3_LD;
+      __eth_tsg[idx].cookie = cookie;
+    }
+    __eth_tsg[idx].busy = true;
+    tdes->tdes2 = tdes2;
+    if (i > 0U) {
+      tdes->tdes3 = tdes3;
+    }
+    else {
+      first_tdes3 = tdes3;
+    }
+
+    if (++tdes >= &__eth_td[STM32_MAC_TRANSMIT_BUFFERS])
+      tdes = &__eth_td[0];
+  }
+
+  /* The DMA must not see the first descriptor before the others.*/
+  __DMB();
+  first_tdes->tdes3 = first_tdes3;
+
+  /* Wait for the write to tdes3 to go through before resuming the DMA.*/
+  __DSB();
+
+  /* Triggering the TX DMA.*/
+  ETH->DMACTDTPR = (uint32_t)tdes - (uint32_t)&__eth_td[0];
+  __eth_tcookies++;
+
+  return MSG_OK;
+}
+
+/**
+ * @brief   Returns the cookie of a transmitted scatter-gather frame.
+ * @details The threads waiting for descriptors are woken if the cookies
+ *          limit was reached.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] tsp      pointer to the transmission timestamp of the frame,
+ *                      can be @p NULL
+ * @return              The cookie of the transmitted frame.
+ * @retval NULL         no transmitted frames to be reclaimed.
+ *
+ * @notapi
+ */
+void *mac_lld_reclaim_transmit_buffers(MACDriver *macp,
+                                       mactimestamp_t *tsp) {
+  void *cookie;
+
+  mac_lld_collect_transmitted();
+
+  if (__eth_tdone_cnt == 0U)
+    return NULL;
+
+  cookie = __eth_tdone[__eth_tdone_rd].cookie;
+  if (tsp != NULL) {
+    *tsp = __eth_tdone[__eth_tdone_rd].ts;
+  }
+  __eth_tdone_rd = (__eth_tdone_rd + 1U) % STM32_MAC_TRANSMIT_COOKIES;
+  __eth_tdone_cnt--;
+  if (__eth_tcookies-- >= STM32_MAC_TRANSMIT_COOKIES) {
+    osalThreadDequeueAllI(&macp->tdqueue, MSG_OK);
+  }
+
+  return cookie;
+}
+#endif /* MAC_USE_SCATTER_GATHER */
+
+#if MAC_USE_TIMESTAMPS || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the current time of the timestamping clock.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] tsp      pointer to the timestamp to be filled
+ *
+ * @notapi
+ */
+void mac_lld_get_timestamp(MACDriver *macp, mactimestamp_t *tsp) {
+  uint32_t sec;
+
+  (void)macp;
+
+  /* Reading again if the seconds changed while reading nanoseconds.*/
+  do {
+    sec       = ETH->MACSTSR;
+    tsp->nsec = ETH->MACSTNR & ETH_MACSTNR_TSSS;
+    tsp->sec  = ETH->MACSTSR;
+  } while (sec != tsp->sec);
+}
+#endif /* MAC_USE_TIMESTAMPS */
+
+#if MAC_USE_STATISTICS || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the MAC statistics.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] sp       pointer to the statistics to be filled
+ *
+ * @notapi
+ */
+void mac_lld_get_statistics(MACDriver *macp, macstatistics_t *sp) {
+
+  /* The MMC counters are cleared on read.*/
+  __eth_stats.tx_frames           += ETH->MMCTPCGR;
+  __eth_stats.tx_collisions       += ETH->MMCTSCGPR;
+  __eth_stats.tx_collisions       += ETH->MMCTMCGPR;
+  __eth_stats.rx_unicast_frames   += ETH->MMCRUPGR;
+  __eth_stats.rx_crc_errors       += ETH->MMCRCRCEPR;
+  __eth_stats.rx_alignment_errors += ETH->MMCRAEPR;
+  mac_lld_collect_drops();
+
+  *sp = __eth_stats;
+  sp->rx_checksum_errors     = macp->rxcsumerrs;
+  sp->rx_flow_control_events = macp->rxfcevents;
+}
+#endif /* MAC_USE_STATISTICS */
+
+#if MAC_USE_RING_STATISTICS || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the descriptor rings occupancy statistics.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] rsp      pointer to the statistics to be filled
+ *
+ * @notapi
+ */
+void mac_lld_get_ring_statistics(MACDriver *macp,
+                                 macringstatistics_t *rsp) {
+
+  (void)macp;
+
+  mac_lld_sample_rings();
+  *rsp = __eth_rings;
+}
+#endif /* MAC_USE_RING_STATISTICS */
+
+#if MAC_USE_FILTERS || defined(__DOXYGEN__)
+/**
+ * @brief   Adds a multicast address to the receive filters.
+ * @details The perfect filter slots are used first, then the hash filter.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] addr      pointer to a six bytes multicast address
+ *
+ * @notapi
+ */
+void mac_lld_add_multicast_address(MACDriver *macp, const uint8_t *addr) {
+  unsigned i, free_slot = 3U;
+
+  (void)macp;
+
+  for (i = 0U; i < 3U; i++) {
+    if (filter_mcslot[i].refs == 0U) {
+      if (free_slot == 3U)
+        free_slot = i;
+    }
+    else if (memcmp(filter_mcslot[i].addr, addr, 6U) == 0) {
+      filter_mcslot[i].refs++;
+      return;
+    }
+  }
+
+  if (free_slot < 3U) {
+    memcpy(filter_mcslot[free_slot].addr, addr, 6U);
+    filter_mcslot[free_slot].refs = 1U;
+  }
+  else {
+    filter_hashrefs[mac_lld_hash_bin(addr)]++;
+  }
+
+  mac_lld_update_filters();
+}
+
+/**
+ * @brief   Removes a multicast address from the receive filters.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] addr      pointer to a six bytes multicast address
+ * @return              The operation status.
+ * @retval MSG_OK       the address has been removed.
+ * @retval MSG_RESET    the address was not registered.
+ *
+ * @notapi
+ */
+msg_t mac_lld_remove_multicast_address(MACDriver *macp,
+                                       const uint8_t *addr) {
+  unsigned i, bin;
+
+  (void)macp;
+
+  for (i = 0U; i < 3U; i++) {
+    if ((filter_mcslot[i].refs > 0U) &&
+        (memcmp(filter_mcslot[i].addr, addr, 6U) == 0)) {
+      filter_mcslot[i].refs--;
+      mac_lld_update_filters();
+      return MSG_OK;
+    }
+  }
+
+  /* Addresses in the hash filter cannot be told apart, the bin is freed
+     when its last reference is removed.*/
+  bin = mac_lld_hash_bin(addr);
+  if (filter_hashrefs[bin] == 0U)
+    return MSG_RESET;
+
+  filter_hashrefs[bin]--;
+  mac_lld_update_filters();
+
+  return MSG_OK;
+}
+
+/**
+ * @brief   Sets the receive filter mode.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] mode      the new filter mode
+ *
+ * @notapi
+ */
+void mac_lld_set_filter_mode(MACDriver *macp, macfiltermode_t mode) {
+
+  (void)macp;
+
+  filter_mode = mode;
+  mac_lld_update_filters();
+}
+#endif /* MAC_USE_FILTERS */
+
+#if MAC_USE_ZERO_COPY || defined(__DOXYGEN__)
+/**
+ * @brief   Returns a pointer to the next transmit buffer in the descriptor
+ *          chain.
+ * @note    The API guarantees that enough buffers can be requested to fill
+ *          a whole frame.
+ *
+ * @param[in] tdp       pointer to a @p MACTransmitDescriptor structure
+ * @param[in] size      size of the requested buffer. Specify the frame size
+ *                      on the first call then scale the value down subtracting
+ *                      the amount of data already copied into the previous
+ *                      buffers.
+ * @param[out] sizep    pointer to variable receiving the real buffer size.
+ *                      The returned value can be less than the amount
+ *                      requested, this means that more buffers must be
+ *                      requested in order to fill the frame data entirely.
+ * @return              Pointer to the returned buffer.
+ * @retval NULL         if the buffer chain has been entirely scanned.
+ *
+ * @notapi
+ */
+uint8_t *mac_lld_get_next_transmit_buffer(MACTransmitDescriptor *tdp,
+                                          size_t size,
+                                          size_t *sizep) {
+
+  osalDbgAssert(!(tdp->physdesc->tdes3 & STM32_TDES3_OWN),
+              "attempt to write descriptor already owned by DMA");
+
+  if (tdp->offset == 0U) {
+    *sizep      = tdp->size;
+    tdp->offset = size < tdp->size ? size : tdp->size;
+    return (uint8_t *)tdp->physdesc->tdes0;
+  }
+  *sizep = 0U;
+  return NULL;
+}
+
+/**
+ * @brief   Returns a pointer to the next receive buffer in the descriptor
+ *          chain.
+ * @note    The API guarantees that the descriptor chain contains a whole
+ *          frame.
+ *
+ * @param[in] rdp       pointer to a @p MACReceiveDescriptor structure
+ * @param[out] sizep    pointer to variable receiving the buffer size, it is
+ *                      zero when the last buffer has already been returned.
+ * @return              Pointer to the returned buffer.
+ * @retval NULL         if the buffer chain has been entirely scanned.
+ *
+ * @notapi
+ */
+const uint8_t *mac_lld_get_next_receive_buffer(MACReceiveDescriptor *rdp,
+                                               size_t *sizep) {
+
+  const uint8_t *p;
+
+  osalDbgAssert(!(rdp->physdesc->rdes3 & STM32_RDES3_OWN),
+              "attempt to read descriptor already owned by DMA");
+
+  if (rdp->offset < rdp->size) {
+    p = mac_lld_rdes_chunk(rdp, sizep);
+    rdp->offset += *sizep;
+    return p;
+  }
+  *sizep = 0U;
+  return NULL;
+}
+#endif /* MAC_USE_ZERO_COPY */
+
 #endif /* HAL_USE_MAC */
 
 /** @} */
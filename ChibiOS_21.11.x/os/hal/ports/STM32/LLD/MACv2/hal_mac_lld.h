@@ -32,9 +32,34 @@
 /*===========================================================================*/
 
 /**
- * @brief   This implementation does not support the zero-copy mode API.
+ * @brief   This implementation supports the zero-copy mode API.
  */
-#define MAC_SUPPORTS_ZERO_COPY      FALSE
+#define MAC_SUPPORTS_ZERO_COPY      TRUE
+
+/**
+ * @brief   This implementation supports the scatter-gather transmit API.
+ */
+#define MAC_SUPPORTS_SCATTER_GATHER TRUE
+
+/**
+ * @brief   This implementation supports the hardware receive filters API.
+ */
+#define MAC_SUPPORTS_FILTERS        TRUE
+
+/**
+ * @brief   This implementation supports the hardware statistics API.
+ */
+#define MAC_SUPPORTS_STATISTICS     TRUE
+
+/**
+ * @brief   This implementation supports hardware timestamping.
+ */
+#define MAC_SUPPORTS_TIMESTAMPS     TRUE
+
+/**
+ * @brief   This implementation supports the rings occupancy statistics API.
+ */
+#define MAC_SUPPORTS_RING_STATISTICS TRUE
 
 /**
  * @name    RDES1 constants
@@ -67,6 +92,7 @@
 #define STM32_RDES2_SAF             0x00001000
 #define STM32_RDES2_VF              0x00000800
 #define STM32_RDES2_RES1            0x00000780
+#define STM32_RDES2_LOCKED          0x00000400 /* NOTE: Pseudo flag.        */
 #define STM32_RDES2_ARPNR           0x00000040
 #define STM32_RDES2_RES2            0x0000003F
 /** @} */
@@ -92,6 +118,7 @@
 #define STM32_RDES3_RE              0x00100000
 #define STM32_RDES3_DE              0x00080000
 #define STM32_RDES3_LT_MASK         0x00070000
+#define STM32_RDES3_LT_CONTROL      0x00060000
 #define STM32_RDES3_ES              0x00008000
 #define STM32_RDES3_PL_MASK         0x00007FFF
 /** @} */
@@ -132,6 +159,7 @@
 #define STM32_TDES3_TSE             0x00040000
 #define STM32_TDES3_CIC_MASK        0x00030000
 #define STM32_TDES3_CIC(n)          ((n) << 16)
+#define STM32_TDES3_TTSS            0x00020000 /* Write */
 #define STM32_TDES3_TPL             0x00008000
 #define STM32_TDES3_FL              0x00007FFF
 /** @} */
@@ -145,6 +173,11 @@
 #define MAC_LINK_10_FULLDUPLEX      2
 /** @} */
 
+/**
+ * @brief   Size of the MTL receive FIFO.
+ */
+#define STM32_MAC_RX_FIFO_SIZE      2048
+
 /*===========================================================================*/
 /* Driver pre-compile time settings.                                         */
 /*===========================================================================*/
@@ -160,6 +193,17 @@
 #define STM32_MAC_TRANSMIT_BUFFERS          4
 #endif
 
+/**
+ * @brief   Number of scatter-gather frames retained until reclaimed.
+ * @details Frames in flight and transmitted frames whose cookie has not
+ *          been reclaimed yet, frames are refused beyond this limit. It
+ *          should cover the frames refilled from the interrupt between two
+ *          reclaims.
+ */
+#if !defined(STM32_MAC_TRANSMIT_COOKIES) || defined(__DOXYGEN__)
+#define STM32_MAC_TRANSMIT_COOKIES          (STM32_MAC_TRANSMIT_BUFFERS * 4)
+#endif
+
 /**
  * @brief   Number of available receive buffers.
  */
@@ -174,6 +218,68 @@
 #define STM32_MAC_BUFFERS_SIZE              1524
 #endif
 
+/**
+ * @brief   IEEE 802.3x flow control.
+ * @details If enabled the pause capability is advertised and, if the link
+ *          partner supports it on a full duplex link, pause frames are sent
+ *          when the receive FIFO fills above the activation threshold and
+ *          received pause frames stop the transmitter.
+ */
+#if !defined(STM32_MAC_FLOW_CONTROL) || defined(__DOXYGEN__)
+#define STM32_MAC_FLOW_CONTROL              FALSE
+#endif
+
+/**
+ * @brief   Pause time sent in pause frames.
+ * @note    In units of 512 bit times.
+ */
+#if !defined(STM32_MAC_PAUSE_TIME) || defined(__DOXYGEN__)
+#define STM32_MAC_PAUSE_TIME                256
+#endif
+
+/**
+ * @brief   Receive FIFO flow control activation threshold.
+ * @details Pause frames are sent when the free space in the receive FIFO
+ *          falls below (N + 2) * 512 bytes.
+ * @note    Range is 0..1, the threshold must be within the 2kB receive
+ *          FIFO.
+ */
+#if !defined(STM32_MAC_RX_FC_ACTIVATE) || defined(__DOXYGEN__)
+#define STM32_MAC_RX_FC_ACTIVATE            0
+#endif
+
+/**
+ * @brief   Receive FIFO flow control deactivation threshold.
+ * @details A zero pause frame is sent when the free space in the receive
+ *          FIFO rises above (N + 2) * 512 bytes.
+ * @note    Range is 0..1, it must not be lower than
+ *          @p STM32_MAC_RX_FC_ACTIVATE.
+ */
+#if !defined(STM32_MAC_RX_FC_DEACTIVATE) || defined(__DOXYGEN__)
+#define STM32_MAC_RX_FC_DEACTIVATE          1
+#endif
+
+/**
+ * @brief   Size of the receive buffers.
+ * @details Frames larger than a receive buffer are spread over multiple
+ *          consecutive receive descriptors.
+ * @note    Must be a multiple of 4.
+ */
+#if !defined(STM32_MAC_RX_BUFFERS_SIZE) || defined(__DOXYGEN__)
+#define STM32_MAC_RX_BUFFERS_SIZE           ((((STM32_MAC_BUFFERS_SIZE - 1) | 3) + 1))
+#endif
+
+/**
+ * @brief   Frame buffers in cacheable memory.
+ * @details If enabled the frame buffers are allocated in the cacheable
+ *          @p .ram0 section and kept coherent by cache maintenance when
+ *          their ownership is transferred, only the descriptors are
+ *          allocated in the non-cacheable @p .eth section.
+ */
+#if !defined(STM32_MAC_BUFFERS_CACHED) || defined(__DOXYGEN__)
+#define STM32_MAC_BUFFERS_CACHED            FALSE
+#endif
+
 /**
  * @brief   PHY detection timeout.
  * @details Timeout for PHY address detection, the scan for a PHY is performed
@@ -193,6 +299,17 @@
 #define STM32_MAC_ETH1_CHANGE_PHY_STATE     TRUE
 #endif
 
+/**
+ * @brief   PHY link interrupt.
+ * @details If enabled the PHY is programmed to assert its interrupt output
+ *          on link changes and auto-negotiation completion, the interrupt
+ *          is acknowledged by @p mac_lld_poll_link_status().
+ * @note    Supported PHYs are the DP83848 and the LAN87xx families.
+ */
+#if !defined(STM32_MAC_PHY_INTERRUPT) || defined(__DOXYGEN__)
+#define STM32_MAC_PHY_INTERRUPT             FALSE
+#endif
+
 /**
  * @brief   ETHD1 interrupt priority level setting.
  */
@@ -223,12 +340,126 @@
 #if !defined(STM32_MAC_PHY_LINK_TYPE) || defined(__DOXYGEN__)
 #define STM32_MAC_PHY_LINK_TYPE             MAC_LINK_DYNAMIC
 #endif
+
+/**
+ * @brief   Frequency of the timestamping clock.
+ * @details The sub-second counter is incremented by the period of this
+ *          clock, the clock is derived from HCLK by the fine correction
+ *          method so it must be lower than HCLK.
+ */
+#if !defined(STM32_MAC_PTP_FREQUENCY) || defined(__DOXYGEN__)
+#define STM32_MAC_PTP_FREQUENCY             50000000
+#endif
+
+/**
+ * @brief   Receive interrupts coalescing.
+ * @details When enabled only one every @p STM32_MAC_RX_FRAMES_THRESHOLD
+ *          frames raises an interrupt, the remaining frames are signaled
+ *          by the DMA receive watchdog. The receive interrupt is also
+ *          masked after being served and enabled again when the ring is
+ *          found empty.
+ */
+#if !defined(STM32_MAC_RX_COALESCING) || defined(__DOXYGEN__)
+#define STM32_MAC_RX_COALESCING             FALSE
+#endif
+
+/**
+ * @brief   Receive frames count interrupt threshold.
+ */
+#if !defined(STM32_MAC_RX_FRAMES_THRESHOLD) || defined(__DOXYGEN__)
+#define STM32_MAC_RX_FRAMES_THRESHOLD       4
+#endif
+
+/**
+ * @brief   Receive interrupt watchdog timeout.
+ * @details Delay, in units of 256 AHB clock cycles, after which an
+ *          interrupt is raised for frames received without interrupt.
+ */
+#if !defined(STM32_MAC_RX_WATCHDOG) || defined(__DOXYGEN__)
+#define STM32_MAC_RX_WATCHDOG               128
+#endif
 /** @} */
 
 /*===========================================================================*/
 /* Derived constants and error checks.                                       */
 /*===========================================================================*/
 
+/**
+ * @brief   Maximum number of buffers in a scatter-gather frame.
+ * @note    Each transmit descriptor points to two buffers and a frame must
+ *          leave a descriptor of the ring free, the tail pointer cannot be
+ *          moved on the descriptor the DMA is suspended on.
+ */
+#define MAC_MAX_FRAME_BUFFERS       ((STM32_MAC_TRANSMIT_BUFFERS - 1) * 2)
+
+/**
+ * @brief   IPv4 header checksum generated and checked by the MAC.
+ */
+#define MAC_OFFLOADS_IP_CHECKSUM    (STM32_MAC_IP_CHECKSUM_OFFLOAD >= 1)
+
+/**
+ * @brief   TCP, UDP and ICMP checksums generated by the MAC.
+ * @note    Mode 2 requires the pseudo-header checksum to be calculated in
+ *          software so it does not count as a complete offload.
+ */
+#define MAC_OFFLOADS_TX_CHECKSUM    (STM32_MAC_IP_CHECKSUM_OFFLOAD == 3)
+
+/**
+ * @brief   TCP, UDP and ICMP checksums checked by the MAC.
+ * @details Frames with checksum errors are dropped by the driver.
+ */
+#define MAC_OFFLOADS_RX_CHECKSUM    (STM32_MAC_IP_CHECKSUM_OFFLOAD >= 1)
+
+#if (STM32_MAC_PAUSE_TIME < 1) || (STM32_MAC_PAUSE_TIME > 65535)
+#error "invalid STM32_MAC_PAUSE_TIME value"
+#endif
+
+#if (STM32_MAC_RX_FC_ACTIVATE < 0) ||                                       \
+    (STM32_MAC_RX_FC_DEACTIVATE < STM32_MAC_RX_FC_ACTIVATE) ||              \
+    (((STM32_MAC_RX_FC_DEACTIVATE + 2) * 512) >= STM32_MAC_RX_FIFO_SIZE)
+#error "invalid STM32_MAC_RX_FC_ACTIVATE or STM32_MAC_RX_FC_DEACTIVATE value"
+#endif
+
+#if ((STM32_MAC_RX_BUFFERS_SIZE % 4) != 0) ||                               \
+    (STM32_MAC_RX_BUFFERS_SIZE < 64)
+#error "invalid STM32_MAC_RX_BUFFERS_SIZE value"
+#endif
+
+#if MAC_USE_SCATTER_GATHER && (STM32_MAC_TRANSMIT_BUFFERS < 2)
+#error "scatter-gather mode requires two STM32_MAC_TRANSMIT_BUFFERS at least"
+#endif
+
+#if STM32_MAC_TRANSMIT_COOKIES < STM32_MAC_TRANSMIT_BUFFERS
+#error "invalid STM32_MAC_TRANSMIT_COOKIES value"
+#endif
+
+#if (STM32_MAC_RX_BUFFERS_SIZE * (STM32_MAC_RECEIVE_BUFFERS - 1)) <         \
+    STM32_MAC_BUFFERS_SIZE
+#error "STM32_MAC_RECEIVE_BUFFERS too small for STM32_MAC_RX_BUFFERS_SIZE"
+#endif
+
+#if MAC_USE_TIMESTAMPS || defined(__DOXYGEN__)
+#if (STM32_MAC_PTP_FREQUENCY >= STM32_HCLK) ||                              \
+    ((1000000000 % STM32_MAC_PTP_FREQUENCY) != 0)
+#error "invalid STM32_MAC_PTP_FREQUENCY value"
+#endif
+#endif
+
+#if (STM32_MAC_IP_CHECKSUM_OFFLOAD < 0) || (STM32_MAC_IP_CHECKSUM_OFFLOAD > 3)
+#error "invalid STM32_MAC_IP_CHECKSUM_OFFLOAD value"
+#endif
+
+#if STM32_MAC_RX_COALESCING || defined(__DOXYGEN__)
+#if (STM32_MAC_RX_FRAMES_THRESHOLD < 1) ||                                  \
+    (STM32_MAC_RX_FRAMES_THRESHOLD > STM32_MAC_RECEIVE_BUFFERS)
+#error "invalid STM32_MAC_RX_FRAMES_THRESHOLD value"
+#endif
+
+#if (STM32_MAC_RX_WATCHDOG < 1) || (STM32_MAC_RX_WATCHDOG > 255)
+#error "invalid STM32_MAC_RX_WATCHDOG value"
+#endif
+#endif
+
 /*===========================================================================*/
 /* Driver data structures and types.                                         */
 /*===========================================================================*/
@@ -264,7 +495,15 @@ typedef struct {
   /* Link status flag.*/                                                    \
   bool                          link_up;                                    \
   /* PHY address (pre shifted).*/                                           \
-  uint32_t                      phyaddr;
+  uint32_t                      phyaddr;                                    \
+  /* Served receive interrupts.*/                                           \
+  uint32_t                      rxirqs;                                     \
+  /* Received frames.*/                                                     \
+  uint32_t                      rxframes;                                   \
+  /* Received frames dropped because of checksum errors.*/                  \
+  uint32_t                      rxcsumerrs;                                 \
+  /* Receive interrupts with the FIFO above the flow control threshold.*/   \
+  uint32_t                      rxfcevents;
 
 /**
  * @brief   Low level fields of the MAC configuration structure.
@@ -284,8 +523,10 @@ typedef struct {
  * @brief   Low level fields of the MAC receive descriptor structure.
  */
 #define mac_lld_receive_descriptor_fields                                   \
-  /* Pointer to the physical descriptor.*/                                  \
-  stm32_eth_rx_descriptor_t     *physdesc;
+  /* Pointer to the first physical descriptor of the frame.*/               \
+  stm32_eth_rx_descriptor_t     *physdesc;                                  \
+  /* Number of physical descriptors spanned by the frame.*/                 \
+  unsigned                      ndesc;
 
 /*===========================================================================*/
 /* External declarations.                                                    */
@@ -316,6 +557,35 @@ extern "C" {
   size_t mac_lld_read_receive_descriptor(MACReceiveDescriptor *rdp,
                                          uint8_t *buf,
                                          size_t size);
+#if MAC_USE_ZERO_COPY
+  uint8_t *mac_lld_get_next_transmit_buffer(MACTransmitDescriptor *tdp,
+                                            size_t size,
+                                            size_t *sizep);
+  const uint8_t *mac_lld_get_next_receive_buffer(MACReceiveDescriptor *rdp,
+                                                 size_t *sizep);
+#endif /* MAC_USE_ZERO_COPY */
+#if MAC_USE_SCATTER_GATHER
+  msg_t mac_lld_transmit_buffers(MACDriver *macp, const macbuffer_t *bp,
+                                 size_t n, void *cookie);
+  void *mac_lld_reclaim_transmit_buffers(MACDriver *macp,
+                                         mactimestamp_t *tsp);
+#endif /* MAC_USE_SCATTER_GATHER */
+#if MAC_USE_TIMESTAMPS
+  void mac_lld_get_timestamp(MACDriver *macp, mactimestamp_t *tsp);
+#endif /* MAC_USE_TIMESTAMPS */
+#if MAC_USE_STATISTICS
+  void mac_lld_get_statistics(MACDriver *macp, macstatistics_t *sp);
+#endif /* MAC_USE_STATISTICS */
+#if MAC_USE_RING_STATISTICS
+  void mac_lld_get_ring_statistics(MACDriver *macp,
+                                   macringstatistics_t *rsp);
+#endif /* MAC_USE_RING_STATISTICS */
+#if MAC_USE_FILTERS
+  void mac_lld_add_multicast_address(MACDriver *macp, const uint8_t *addr);
+  msg_t mac_lld_remove_multicast_address(MACDriver *macp,
+                                         const uint8_t *addr);
+  void mac_lld_set_filter_mode(MACDriver *macp, macfiltermode_t mode);
+#endif /* MAC_USE_FILTERS */
 #ifdef __cplusplus
 }
 #endif
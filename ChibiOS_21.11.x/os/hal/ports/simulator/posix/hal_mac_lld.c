@@ -0,0 +1,1212 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    simulator/posix/hal_mac_lld.c
+ * @brief   Posix simulator low level MAC driver code.
+ * @details The descriptor rings of a real MAC are simulated, frames are
+ *          moved between the rings and the backend by the simulated
+ *          interrupt, see @p mac_lld_interrupt_pending().
+ *
+ * @addtogroup POSIX_MAC
+ * @{
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+#endif
+
+#include "hal.h"
+
+#if HAL_USE_MAC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @name    Simulated descriptor states
+ * @{
+ */
+#define SIM_DESC_FREE               0U  /**< Available to the driver.       */
+#define SIM_DESC_LOCKED             1U  /**< Used by the upper layer.       */
+#define SIM_DESC_OWN                2U  /**< Owned by the simulated DMA.    */
+/** @} */
+
+/**
+ * @name    Pcap file format
+ * @{
+ */
+#define PCAP_MAGIC_USEC             0xA1B2C3D4U
+#define PCAP_MAGIC_NSEC             0xA1B23C4DU
+#define PCAP_LINKTYPE_ETHERNET      1U
+/** @} */
+
+/*===========================================================================*/
+/* Driver exported variables.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Ethernet driver 1.
+ */
+MACDriver ETHD1;
+
+/*===========================================================================*/
+/* Driver local variables and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Pcap record header.
+ */
+typedef struct {
+  uint32_t              ts_sec;
+  uint32_t              ts_frac;
+  uint32_t              incl_len;
+  uint32_t              orig_len;
+} pcap_record_t;
+
+static const uint8_t default_mac_address[] = {0xAA, 0x55, 0x13,
+                                              0x37, 0x01, 0x10};
+
+static sim_mac_descriptor_t sim_rd[SIM_MAC_RECEIVE_BUFFERS];
+static sim_mac_descriptor_t sim_td[SIM_MAC_TRANSMIT_BUFFERS];
+
+/* Next receive descriptor to be filled by the simulated DMA and next one
+   to be returned to the upper layer.*/
+static unsigned sim_rd_dma, sim_rd_next;
+
+/* Next transmit descriptor to be sent by the simulated DMA and next one
+   to be returned to the upper layer.*/
+static unsigned sim_td_dma, sim_td_next;
+
+/* Station address.*/
+static uint8_t sim_address[6];
+
+#if (SIM_MAC_BACKEND == SIM_MAC_BACKEND_TAP) || defined(__DOXYGEN__)
+/* Scratch buffer for frames dropped because the receive ring is full.*/
+static uint8_t sim_discard[SIM_MAC_BUFFERS_SIZE];
+#endif
+
+#if MAC_USE_SCATTER_GATHER || defined(__DOXYGEN__)
+/* Cookies of the transmitted scatter-gather frames waiting to be
+   reclaimed.*/
+static struct {
+  void                  *cookie;
+  mactimestamp_t        ts;
+} sim_tdone[SIM_MAC_TRANSMIT_BUFFERS];
+static unsigned sim_tdone_rd, sim_tdone_cnt;
+
+/* Cookies not yet reclaimed, frames in flight included.*/
+static unsigned sim_tcookies;
+#endif
+
+#if MAC_USE_STATISTICS || defined(__DOXYGEN__)
+static macstatistics_t sim_stats;
+#endif
+
+#if MAC_USE_RING_STATISTICS || defined(__DOXYGEN__)
+/* Descriptor rings occupancy.*/
+static macringstatistics_t sim_rings;
+#endif
+
+#if MAC_USE_FILTERS || defined(__DOXYGEN__)
+/* Multicast addresses accepted by the filter, reference counted.*/
+static struct {
+  uint8_t               addr[6];
+  unsigned              refs;
+} sim_mcaddr[SIM_MAC_MULTICAST_ADDRESSES];
+
+/* Multicast addresses that did not fit the filter.*/
+static unsigned sim_mcoverflow;
+
+static macfiltermode_t sim_filtermode;
+#endif
+
+/*===========================================================================*/
+/* Driver local functions.                                                   */
+/*===========================================================================*/
+
+/**
+ * @brief   Returns the current time as a timestamp.
+ *
+ * @param[out] tsp      pointer to the timestamp to be filled
+ */
+static void sim_get_time(mactimestamp_t *tsp) {
+  struct timespec now;
+
+  clock_gettime(CLOCK_REALTIME, &now);
+  tsp->sec  = (uint32_t)now.tv_sec;
+  tsp->nsec = (uint32_t)now.tv_nsec;
+}
+
+#if (SIM_MAC_BACKEND == SIM_MAC_BACKEND_PCAP) || defined(__DOXYGEN__)
+/**
+ * @brief   Swaps the byte order of a word read from the replay file.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] w         the word to be converted
+ * @return              The word in host byte order.
+ */
+static uint32_t sim_pcap_word(MACDriver *macp, uint32_t w) {
+
+  if (macp->rxswapped) {
+    w = ((w & 0x000000FFU) << 24) | ((w & 0x0000FF00U) << 8) |
+        ((w & 0x00FF0000U) >> 8)  | ((w & 0xFF000000U) >> 24);
+  }
+  return w;
+}
+
+/**
+ * @brief   Opens the replay file and checks its header.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @return              The operation status.
+ * @retval false        if the file is not a valid Ethernet capture.
+ */
+static bool sim_pcap_open_input(MACDriver *macp) {
+  uint32_t hdr[6];
+
+  macp->rxfile = fopen(SIM_MAC_PCAP_INPUT, "rb");
+  if (macp->rxfile == NULL) {
+    printf("ETHD1: Unable to open %s\n", SIM_MAC_PCAP_INPUT);
+    return false;
+  }
+
+  if (fread(hdr, sizeof(hdr), 1, macp->rxfile) != 1)
+    return false;
+
+  macp->rxswapped = false;
+  macp->rxnsec    = false;
+  switch (hdr[0]) {
+  case 0xD4C3B2A1U:
+    macp->rxswapped = true;
+    break;
+  case 0x4D3CB2A1U:
+    macp->rxswapped = true;
+    /* Falls through.*/
+  case PCAP_MAGIC_NSEC:
+    macp->rxnsec = true;
+    break;
+  case PCAP_MAGIC_USEC:
+    break;
+  default:
+    printf("ETHD1: %s is not a pcap file\n", SIM_MAC_PCAP_INPUT);
+    return false;
+  }
+
+  if (sim_pcap_word(macp, hdr[5]) != PCAP_LINKTYPE_ETHERNET) {
+    printf("ETHD1: %s is not an Ethernet capture\n", SIM_MAC_PCAP_INPUT);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief   Reads the next frame from the replay file.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] rdes     pointer to the descriptor receiving the frame
+ * @return              The operation status.
+ * @retval false        if there are no more frames to replay.
+ */
+static bool sim_pcap_read(MACDriver *macp, sim_mac_descriptor_t *rdes) {
+  pcap_record_t rec;
+
+  while (true) {
+    if (fread(&rec, sizeof(rec), 1, macp->rxfile) != 1) {
+#if SIM_MAC_PCAP_LOOP
+      /* Starting again after the file header.*/
+      if (fseek(macp->rxfile, 24L, SEEK_SET) == 0) {
+        continue;
+      }
+#endif
+      macp->rxeof = true;
+      return false;
+    }
+
+    rdes->size = (size_t)sim_pcap_word(macp, rec.incl_len);
+    if (rdes->size <= SIM_MAC_BUFFERS_SIZE) {
+      break;
+    }
+
+    /* Oversized frames are skipped.*/
+    printf("ETHD1: skipped %u bytes frame\n", (unsigned)rdes->size);
+    if (fseek(macp->rxfile, (long)rdes->size, SEEK_CUR) != 0) {
+      macp->rxeof = true;
+      return false;
+    }
+  }
+
+  if (fread(rdes->buf, 1, rdes->size, macp->rxfile) != rdes->size) {
+    macp->rxeof = true;
+    return false;
+  }
+
+  /* The recorded time is used as reception time, replays are repeatable.*/
+  rdes->ts.sec  = sim_pcap_word(macp, rec.ts_sec);
+  rdes->ts.nsec = sim_pcap_word(macp, rec.ts_frac);
+  if (!macp->rxnsec) {
+    rdes->ts.nsec *= 1000U;
+  }
+
+  return true;
+}
+#endif /* SIM_MAC_BACKEND == SIM_MAC_BACKEND_PCAP */
+
+/**
+ * @brief   Creates the capture file.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ */
+static void sim_pcap_open_output(MACDriver *macp) {
+  const char *name = SIM_MAC_PCAP_OUTPUT;
+  static const uint32_t hdr[6] = {PCAP_MAGIC_NSEC, 0x00040002U, 0U, 0U,
+                                  65535U, PCAP_LINKTYPE_ETHERNET};
+
+  if (name == NULL)
+    return;
+
+  macp->txfile = fopen(name, "wb");
+  if ((macp->txfile == NULL) ||
+      (fwrite(hdr, sizeof(hdr), 1, macp->txfile) != 1)) {
+    printf("ETHD1: Unable to create %s\n", name);
+    exit(1);
+  }
+}
+
+/**
+ * @brief   Appends a transmitted frame to the capture file.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] tdes      pointer to the transmitted descriptor
+ */
+static void sim_pcap_write(MACDriver *macp, sim_mac_descriptor_t *tdes) {
+  pcap_record_t rec;
+
+  if (macp->txfile == NULL)
+    return;
+
+  rec.ts_sec   = tdes->ts.sec;
+  rec.ts_frac  = tdes->ts.nsec;
+  rec.incl_len = (uint32_t)tdes->size;
+  rec.orig_len = (uint32_t)tdes->size;
+  (void)fwrite(&rec, sizeof(rec), 1, macp->txfile);
+  (void)fwrite(tdes->buf, 1, tdes->size, macp->txfile);
+}
+
+#if (SIM_MAC_BACKEND == SIM_MAC_BACKEND_TAP) || defined(__DOXYGEN__)
+/**
+ * @brief   Attaches to the TAP interface.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @return              The operation status.
+ * @retval false        if the interface cannot be opened.
+ */
+static bool sim_tap_open(MACDriver *macp) {
+  struct ifreq ifr;
+
+  macp->fd = open("/dev/net/tun", O_RDWR | O_NONBLOCK);
+  if (macp->fd == -1) {
+    printf("ETHD1: Unable to open /dev/net/tun\n");
+    return false;
+  }
+
+  memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+  strncpy(ifr.ifr_name, SIM_MAC_TAP_NAME, IFNAMSIZ - 1);
+  if (ioctl(macp->fd, TUNSETIFF, &ifr) != 0) {
+    printf("ETHD1: Unable to attach to %s\n", SIM_MAC_TAP_NAME);
+    return false;
+  }
+
+  printf("ETHD1: attached to %s\n", SIM_MAC_TAP_NAME);
+  return true;
+}
+
+/**
+ * @brief   Returns the host side state of the TAP interface.
+ *
+ * @return              The interface state.
+ * @retval true         if the interface is up.
+ */
+static bool sim_tap_is_up(void) {
+  struct ifreq ifr;
+  int s;
+
+  s = socket(AF_INET, SOCK_DGRAM, 0);
+  if (s == -1)
+    return false;
+
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, SIM_MAC_TAP_NAME, IFNAMSIZ - 1);
+  if (ioctl(s, SIOCGIFFLAGS, &ifr) != 0) {
+    ifr.ifr_flags = 0;
+  }
+  close(s);
+
+  return (ifr.ifr_flags & IFF_UP) != 0;
+}
+#endif /* SIM_MAC_BACKEND == SIM_MAC_BACKEND_TAP */
+
+/**
+ * @brief   Checks a received frame against the receive filter.
+ *
+ * @param[in] rdes      pointer to the received descriptor
+ * @return              The filter result.
+ * @retval true         if the frame is accepted.
+ */
+static bool sim_filter_accepts(const sim_mac_descriptor_t *rdes) {
+  const uint8_t *da = rdes->buf;
+
+  if (rdes->size < 14U)
+    return false;
+
+  /* Unicast frames only if addressed to the station.*/
+  if ((da[0] & 1U) == 0U) {
+#if MAC_USE_FILTERS
+    if (sim_filtermode == MAC_FILTER_PROMISCUOUS)
+      return true;
+#endif
+    return memcmp(da, sim_address, 6U) == 0;
+  }
+
+#if MAC_USE_FILTERS
+  {
+    static const uint8_t bcast[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    unsigned i;
+
+    if ((sim_filtermode != MAC_FILTER_NORMAL) || (sim_mcoverflow > 0U) ||
+        (memcmp(da, bcast, 6U) == 0))
+      return true;
+
+    for (i = 0U; i < SIM_MAC_MULTICAST_ADDRESSES; i++) {
+      if ((sim_mcaddr[i].refs > 0U) &&
+          (memcmp(sim_mcaddr[i].addr, da, 6U) == 0))
+        return true;
+    }
+    return false;
+  }
+#else
+  /* Broadcast and all multicast frames.*/
+  return true;
+#endif
+}
+
+/**
+ * @brief   Simulated receive DMA.
+ * @details Incoming frames are moved into the free receive descriptors.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @return              The number of frames received.
+ */
+static unsigned sim_receive(MACDriver *macp) {
+  unsigned n = 0U;
+
+  while (true) {
+    sim_mac_descriptor_t *rdes = &sim_rd[sim_rd_dma];
+    bool full = rdes->state != SIM_DESC_OWN;
+
+#if SIM_MAC_BACKEND == SIM_MAC_BACKEND_TAP
+    ssize_t size;
+
+    /* With the ring full the frame is read anyway and dropped, the host
+       side does not wait for the simulated MAC.*/
+    size = read(macp->fd, full ? sim_discard : rdes->buf,
+                SIM_MAC_BUFFERS_SIZE);
+    if (size <= 0)
+      break;
+    if (full) {
+#if MAC_USE_STATISTICS
+      sim_stats.rx_missed_frames++;
+#endif
+      continue;
+    }
+    rdes->size = (size_t)size;
+    sim_get_time(&rdes->ts);
+#else
+    /* Replayed frames wait for a free descriptor.*/
+    if (full || macp->rxeof || !sim_pcap_read(macp, rdes))
+      break;
+#endif
+
+    if (!sim_filter_accepts(rdes))
+      continue;
+
+#if MAC_USE_STATISTICS
+    if ((rdes->buf[0] & 1U) == 0U) {
+      sim_stats.rx_unicast_frames++;
+    }
+#endif
+
+    osalSysLockFromISR();
+    rdes->state = SIM_DESC_FREE;
+    osalSysUnlockFromISR();
+    sim_rd_dma = (sim_rd_dma + 1U) % SIM_MAC_RECEIVE_BUFFERS;
+    n++;
+  }
+
+  return n;
+}
+
+/**
+ * @brief   Simulated transmit DMA.
+ * @details The frames in the descriptors released by the upper layer are
+ *          sent in order.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @return              The number of frames transmitted.
+ */
+static unsigned sim_transmit(MACDriver *macp) {
+  unsigned n = 0U;
+
+  while (sim_td[sim_td_dma].state == SIM_DESC_OWN) {
+    sim_mac_descriptor_t *tdes = &sim_td[sim_td_dma];
+
+    sim_get_time(&tdes->ts);
+#if SIM_MAC_BACKEND == SIM_MAC_BACKEND_TAP
+    /* Frames refused by the host are lost as on a real wire.*/
+    (void)write(macp->fd, tdes->buf, tdes->size);
+#endif
+    sim_pcap_write(macp, tdes);
+
+#if MAC_USE_STATISTICS
+    sim_stats.tx_frames++;
+#endif
+
+    osalSysLockFromISR();
+#if MAC_USE_SCATTER_GATHER
+    if (tdes->cookie != NULL) {
+      unsigned j = (sim_tdone_rd + sim_tdone_cnt) % SIM_MAC_TRANSMIT_BUFFERS;
+
+      sim_tdone[j].cookie = tdes->cookie;
+#if MAC_USE_TIMESTAMPS
+      sim_tdone[j].ts     = tdes->ts;
+#else
+      sim_tdone[j].ts.nsec = MAC_TIMESTAMP_INVALID;
+#endif
+      sim_tdone_cnt++;
+      tdes->cookie = NULL;
+    }
+#endif
+    tdes->state = SIM_DESC_FREE;
+    osalSysUnlockFromISR();
+
+    sim_td_dma = (sim_td_dma + 1U) % SIM_MAC_TRANSMIT_BUFFERS;
+    n++;
+  }
+
+  if ((n > 0U) && (macp->txfile != NULL)) {
+    (void)fflush(macp->txfile);
+  }
+
+  return n;
+}
+
+#if MAC_USE_RING_STATISTICS || defined(__DOXYGEN__)
+/**
+ * @brief   Samples the occupancy of the descriptor rings.
+ */
+static void sim_sample_rings(void) {
+  uint32_t rxused = 0U, txused = 0U;
+  unsigned i;
+
+  for (i = 0U; i < SIM_MAC_RECEIVE_BUFFERS; i++) {
+    if (sim_rd[i].state != SIM_DESC_OWN) {
+      rxused++;
+    }
+  }
+  for (i = 0U; i < SIM_MAC_TRANSMIT_BUFFERS; i++) {
+    if (sim_td[i].state != SIM_DESC_FREE) {
+      txused++;
+    }
+  }
+  macOccupancySampleX(&sim_rings.rx, rxused);
+  macOccupancySampleX(&sim_rings.tx, txused);
+}
+#endif
+
+/*===========================================================================*/
+/* Driver interrupt handlers.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Simulated MAC interrupt.
+ * @details Pending transmissions and receptions are served, it is invoked
+ *          by the simulated interrupts check.
+ *
+ * @return              The interrupt status.
+ * @retval true         if frames have been transmitted or received.
+ *
+ * @notapi
+ */
+bool mac_lld_interrupt_pending(void) {
+  MACDriver *macp = &ETHD1;
+  unsigned txn, rxn;
+
+  if ((macp->state != MAC_ACTIVE) || !macp->link_up)
+    return false;
+
+  OSAL_IRQ_PROLOGUE();
+
+  txn = sim_transmit(macp);
+  if (txn > 0U) {
+    /* Data Transmitted.*/
+    __mac_tx_wakeup(macp);
+  }
+
+  rxn = sim_receive(macp);
+  if (rxn > 0U) {
+    /* Data Received.*/
+    macp->rxirqs++;
+    __mac_rx_wakeup(macp);
+  }
+
+  if ((txn > 0U) || (rxn > 0U)) {
+#if MAC_USE_RING_STATISTICS
+    osalSysLockFromISR();
+    sim_sample_rings();
+    osalSysUnlockFromISR();
+#endif
+    __mac_callback(macp);
+  }
+
+  OSAL_IRQ_EPILOGUE();
+
+  return (txn > 0U) || (rxn > 0U);
+}
+
+/*===========================================================================*/
+/* Driver exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level MAC initialization.
+ *
+ * @notapi
+ */
+void mac_lld_init(void) {
+
+  macObjectInit(&ETHD1);
+  ETHD1.link_up      = false;
+  ETHD1.link_enabled = true;
+  ETHD1.fd           = -1;
+  ETHD1.rxfile       = NULL;
+  ETHD1.txfile       = NULL;
+}
+
+/**
+ * @brief   Configures and activates the MAC peripheral.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ *
+ * @notapi
+ */
+void mac_lld_start(MACDriver *macp) {
+  unsigned i;
+
+  /* All the receive descriptors are given to the simulated DMA.*/
+  for (i = 0U; i < SIM_MAC_RECEIVE_BUFFERS; i++) {
+    sim_rd[i].state = SIM_DESC_OWN;
+  }
+  for (i = 0U; i < SIM_MAC_TRANSMIT_BUFFERS; i++) {
+    sim_td[i].state  = SIM_DESC_FREE;
+    sim_td[i].cookie = NULL;
+  }
+  sim_rd_dma  = 0U;
+  sim_rd_next = 0U;
+  sim_td_dma  = 0U;
+  sim_td_next = 0U;
+#if MAC_USE_SCATTER_GATHER
+  sim_tdone_rd  = 0U;
+  sim_tdone_cnt = 0U;
+  sim_tcookies  = 0U;
+#endif
+#if MAC_USE_STATISTICS
+  memset(&sim_stats, 0, sizeof(sim_stats));
+#endif
+#if MAC_USE_RING_STATISTICS
+  macOccupancyObjectInit(&sim_rings.rx, SIM_MAC_RECEIVE_BUFFERS);
+  macOccupancyObjectInit(&sim_rings.tx, SIM_MAC_TRANSMIT_BUFFERS);
+#endif
+
+  macp->rxirqs   = 0U;
+  macp->rxframes = 0U;
+  macp->rxeof    = false;
+
+  if (macp->config->mac_address == NULL)
+    memcpy(sim_address, default_mac_address, 6U);
+  else
+    memcpy(sim_address, macp->config->mac_address, 6U);
+
+#if SIM_MAC_BACKEND == SIM_MAC_BACKEND_TAP
+  if (!sim_tap_open(macp))
+    exit(1);
+#else
+  if (!sim_pcap_open_input(macp))
+    exit(1);
+#endif
+  sim_pcap_open_output(macp);
+}
+
+/**
+ * @brief   Deactivates the MAC peripheral.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ *
+ * @notapi
+ */
+void mac_lld_stop(MACDriver *macp) {
+
+  if (macp->state == MAC_ACTIVE) {
+    if (macp->fd != -1) {
+      close(macp->fd);
+      macp->fd = -1;
+    }
+    if (macp->rxfile != NULL) {
+      fclose(macp->rxfile);
+      macp->rxfile = NULL;
+    }
+    if (macp->txfile != NULL) {
+      fclose(macp->txfile);
+      macp->txfile = NULL;
+    }
+    macp->link_up = false;
+  }
+}
+
+/**
+ * @brief   Returns a transmission descriptor.
+ * @details One of the available transmission descriptors is locked and
+ *          returned.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] tdp      pointer to a @p MACTransmitDescriptor structure
+ * @return              The operation status.
+ * @retval MSG_OK       the descriptor has been obtained.
+ * @retval MSG_TIMEOUT  descriptor not available.
+ *
+ * @notapi
+ */
+msg_t mac_lld_get_transmit_descriptor(MACDriver *macp,
+                                      MACTransmitDescriptor *tdp) {
+  sim_mac_descriptor_t *tdes = &sim_td[sim_td_next];
+
+#if MAC_USE_RING_STATISTICS
+  sim_sample_rings();
+#endif
+
+  if (!macp->link_up || (tdes->state != SIM_DESC_FREE))
+    return MSG_TIMEOUT;
+
+  tdes->state = SIM_DESC_LOCKED;
+  sim_td_next = (sim_td_next + 1U) % SIM_MAC_TRANSMIT_BUFFERS;
+
+  tdp->offset   = 0U;
+  tdp->size     = SIM_MAC_BUFFERS_SIZE;
+  tdp->physdesc = tdes;
+
+  return MSG_OK;
+}
+
+/**
+ * @brief   Releases a transmit descriptor and starts the transmission of the
+ *          enqueued data as a single frame.
+ *
+ * @param[in] tdp       the pointer to the @p MACTransmitDescriptor structure
+ *
+ * @notapi
+ */
+void mac_lld_release_transmit_descriptor(MACTransmitDescriptor *tdp) {
+
+  osalDbgAssert(tdp->physdesc->state == SIM_DESC_LOCKED,
+                "attempt to release descriptor already owned by DMA");
+
+  tdp->physdesc->size  = tdp->offset;
+  tdp->physdesc->state = SIM_DESC_OWN;
+}
+
+/**
+ * @brief   Returns a receive descriptor.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] rdp      pointer to a @p MACReceiveDescriptor structure
+ * @return              The operation status.
+ * @retval MSG_OK       the descriptor has been obtained.
+ * @retval MSG_TIMEOUT  descriptor not available.
+ *
+ * @notapi
+ */
+msg_t mac_lld_get_receive_descriptor(MACDriver *macp,
+                                     MACReceiveDescriptor *rdp) {
+  sim_mac_descriptor_t *rdes = &sim_rd[sim_rd_next];
+
+#if MAC_USE_RING_STATISTICS
+  sim_sample_rings();
+#endif
+
+  /* The descriptors are filled and returned in order, the next one is
+     either holding a frame or still owned by the simulated DMA.*/
+  if (rdes->state != SIM_DESC_FREE)
+    return MSG_TIMEOUT;
+
+  rdes->state = SIM_DESC_LOCKED;
+  sim_rd_next = (sim_rd_next + 1U) % SIM_MAC_RECEIVE_BUFFERS;
+  macp->rxframes++;
+
+  rdp->offset   = 0U;
+  rdp->size     = rdes->size;
+  rdp->physdesc = rdes;
+#if MAC_USE_TIMESTAMPS
+  rdp->ts       = rdes->ts;
+#endif
+
+  return MSG_OK;
+}
+
+/**
+ * @brief   Releases a receive descriptor.
+ * @details The descriptor and its buffer are made available for more incoming
+ *          frames.
+ *
+ * @param[in] rdp       the pointer to the @p MACReceiveDescriptor structure
+ *
+ * @notapi
+ */
+void mac_lld_release_receive_descriptor(MACReceiveDescriptor *rdp) {
+
+  osalDbgAssert(rdp->physdesc->state == SIM_DESC_LOCKED,
+                "attempt to release descriptor already owned by DMA");
+
+  rdp->physdesc->state = SIM_DESC_OWN;
+}
+
+/**
+ * @brief   Updates and returns the link status.
+ * @details The link is up if enabled by @p mac_lld_set_link_status() and,
+ *          with the TAP backend, if the host side interface is up.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @return              The link status.
+ * @retval true         if the link is active.
+ * @retval false        if the link is down.
+ *
+ * @notapi
+ */
+bool mac_lld_poll_link_status(MACDriver *macp) {
+
+#if SIM_MAC_BACKEND == SIM_MAC_BACKEND_TAP
+  return macp->link_up = macp->link_enabled && sim_tap_is_up();
+#else
+  return macp->link_up = macp->link_enabled;
+#endif
+}
+
+/**
+ * @brief   Writes to a transmit descriptor's stream.
+ *
+ * @param[in] tdp       pointer to a @p MACTransmitDescriptor structure
+ * @param[in] buf       pointer to the buffer containing the data to be
+ *                      written
+ * @param[in] size      number of bytes to be written
+ * @return              The number of bytes written into the descriptor's
+ *                      stream, this value can be less than the amount
+ *                      specified in the parameter @p size if the maximum
+ *                      frame size is reached.
+ *
+ * @notapi
+ */
+size_t mac_lld_write_transmit_descriptor(MACTransmitDescriptor *tdp,
+                                         uint8_t *buf,
+                                         size_t size) {
+
+  osalDbgAssert(tdp->physdesc->state == SIM_DESC_LOCKED,
+                "attempt to write descriptor already owned by DMA");
+
+  if (size > tdp->size - tdp->offset)
+    size = tdp->size - tdp->offset;
+
+  if (size > 0) {
+    memcpy(tdp->physdesc->buf + tdp->offset, buf, size);
+    tdp->offset += size;
+  }
+  return size;
+}
+
+/**
+ * @brief   Reads from a receive descriptor's stream.
+ *
+ * @param[in] rdp       pointer to a @p MACReceiveDescriptor structure
+ * @param[in] buf       pointer to the buffer that will receive the read data
+ * @param[in] size      number of bytes to be read
+ * @return              The number of bytes read from the descriptor's
+ *                      stream, this value can be less than the amount
+ *                      specified in the parameter @p size if there are
+ *                      no more bytes to read.
+ *
+ * @notapi
+ */
+size_t mac_lld_read_receive_descriptor(MACReceiveDescriptor *rdp,
+                                       uint8_t *buf,
+                                       size_t size) {
+
+  osalDbgAssert(rdp->physdesc->state == SIM_DESC_LOCKED,
+                "attempt to read descriptor already owned by DMA");
+
+  if (size > rdp->size - rdp->offset)
+    size = rdp->size - rdp->offset;
+
+  if (size > 0) {
+    memcpy(buf, rdp->physdesc->buf + rdp->offset, size);
+    rdp->offset += size;
+  }
+  return size;
+}
+
+#if MAC_USE_SCATTER_GATHER || defined(__DOXYGEN__)
+/**
+ * @brief   Enqueues a frame composed of multiple buffers for transmission.
+ * @details The buffers are gathered into a single transmit descriptor, the
+ *          cookie is returned after the simulated transmission as on a
+ *          real MAC.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] bp        pointer to an array of @p macbuffer_t structures
+ * @param[in] n         number of buffers in the array
+ * @param[in] cookie    frame identifier
+ * @return              The operation status.
+ * @retval MSG_OK       the frame has been enqueued.
+ * @retval MSG_TIMEOUT  not enough descriptors available or too many
+ *                      transmitted frames not yet reclaimed.
+ *
+ * @notapi
+ */
+msg_t mac_lld_transmit_buffers(MACDriver *macp, const macbuffer_t *bp,
+                               size_t n, void *cookie) {
+  sim_mac_descriptor_t *tdes = &sim_td[sim_td_next];
+  size_t i;
+
+#if MAC_USE_RING_STATISTICS
+  sim_sample_rings();
+#endif
+
+  if (!macp->link_up || (tdes->state != SIM_DESC_FREE))
+    return MSG_TIMEOUT;
+
+  /* The cookie is queued on transmission, there must be space for it
+     after the cookies of the frames still in flight.*/
+  if (sim_tcookies >= SIM_MAC_TRANSMIT_BUFFERS)
+    return MSG_TIMEOUT;
+
+  tdes->size = 0U;
+  for (i = 0U; i < n; i++) {
+    osalDbgAssert(tdes->size + bp[i].size <= SIM_MAC_BUFFERS_SIZE,
+                  "frame too large");
+
+    memcpy(tdes->buf + tdes->size, bp[i].buf, bp[i].size);
+    tdes->size += bp[i].size;
+  }
+  tdes->cookie = cookie;
+  tdes->state  = SIM_DESC_OWN;
+  sim_td_next  = (sim_td_next + 1U) % SIM_MAC_TRANSMIT_BUFFERS;
+  sim_tcookies++;
+
+  return MSG_OK;
+}
+
+/**
+ * @brief   Returns the cookie of a transmitted scatter-gather frame.
+ * @details The threads waiting for descriptors are woken if the cookies
+ *          limit was reached.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] tsp      pointer to the transmission timestamp of the frame,
+ *                      can be @p NULL
+ * @return              The cookie of the transmitted frame.
+ * @retval NULL         no transmitted frames to be reclaimed.
+ *
+ * @notapi
+ */
+void *mac_lld_reclaim_transmit_buffers(MACDriver *macp,
+                                       mactimestamp_t *tsp) {
+  void *cookie;
+
+  if (sim_tdone_cnt == 0U)
+    return NULL;
+
+  cookie = sim_tdone[sim_tdone_rd].cookie;
+  if (tsp != NULL) {
+    *tsp = sim_tdone[sim_tdone_rd].ts;
+  }
+  sim_tdone_rd = (sim_tdone_rd + 1U) % SIM_MAC_TRANSMIT_BUFFERS;
+  sim_tdone_cnt--;
+  if (sim_tcookies-- >= SIM_MAC_TRANSMIT_BUFFERS) {
+    osalThreadDequeueAllI(&macp->tdqueue, MSG_OK);
+  }
+
+  return cookie;
+}
+#endif /* MAC_USE_SCATTER_GATHER */
+
+#if MAC_USE_TIMESTAMPS || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the current time of the timestamping clock.
+ * @note    The host real time clock is used.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] tsp      pointer to the timestamp to be filled
+ *
+ * @notapi
+ */
+void mac_lld_get_timestamp(MACDriver *macp, mactimestamp_t *tsp) {
+
+  (void)macp;
+
+  sim_get_time(tsp);
+}
+#endif /* MAC_USE_TIMESTAMPS */
+
+#if MAC_USE_STATISTICS || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the MAC statistics.
+ * @note    Only the transmitted, unicast received and missed frames are
+ *          counted, there are no errors on a simulated link.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] sp       pointer to the statistics to be filled
+ *
+ * @notapi
+ */
+void mac_lld_get_statistics(MACDriver *macp, macstatistics_t *sp) {
+
+  (void)macp;
+
+  *sp = sim_stats;
+}
+#endif /* MAC_USE_STATISTICS */
+
+#if MAC_USE_RING_STATISTICS || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the descriptor rings occupancy statistics.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] rsp      pointer to the statistics to be filled
+ *
+ * @notapi
+ */
+void mac_lld_get_ring_statistics(MACDriver *macp,
+                                 macringstatistics_t *rsp) {
+
+  (void)macp;
+
+  sim_sample_rings();
+  *rsp = sim_rings;
+}
+#endif /* MAC_USE_RING_STATISTICS */
+
+#if MAC_USE_FILTERS || defined(__DOXYGEN__)
+/**
+ * @brief   Adds a multicast address to the receive filters.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] addr      pointer to a six bytes multicast address
+ *
+ * @notapi
+ */
+void mac_lld_add_multicast_address(MACDriver *macp, const uint8_t *addr) {
+  unsigned i, free_slot = SIM_MAC_MULTICAST_ADDRESSES;
+
+  (void)macp;
+
+  for (i = 0U; i < SIM_MAC_MULTICAST_ADDRESSES; i++) {
+    if (sim_mcaddr[i].refs == 0U) {
+      if (free_slot == SIM_MAC_MULTICAST_ADDRESSES)
+        free_slot = i;
+    }
+    else if (memcmp(sim_mcaddr[i].addr, addr, 6U) == 0) {
+      sim_mcaddr[i].refs++;
+      return;
+    }
+  }
+
+  if (free_slot < SIM_MAC_MULTICAST_ADDRESSES) {
+    memcpy(sim_mcaddr[free_slot].addr, addr, 6U);
+    sim_mcaddr[free_slot].refs = 1U;
+  }
+  else {
+    sim_mcoverflow++;
+  }
+}
+
+/**
+ * @brief   Removes a multicast address from the receive filters.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] addr      pointer to a six bytes multicast address
+ * @return              The operation status.
+ * @retval MSG_OK       the address has been removed.
+ * @retval MSG_RESET    the address was not registered.
+ *
+ * @notapi
+ */
+msg_t mac_lld_remove_multicast_address(MACDriver *macp,
+                                       const uint8_t *addr) {
+  unsigned i;
+
+  (void)macp;
+
+  for (i = 0U; i < SIM_MAC_MULTICAST_ADDRESSES; i++) {
+    if ((sim_mcaddr[i].refs > 0U) &&
+        (memcmp(sim_mcaddr[i].addr, addr, 6U) == 0)) {
+      sim_mcaddr[i].refs--;
+      return MSG_OK;
+    }
+  }
+
+  /* Addresses that did not fit the filter are not stored, any of them
+     can be removed.*/
+  if (sim_mcoverflow == 0U)
+    return MSG_RESET;
+
+  sim_mcoverflow--;
+
+  return MSG_OK;
+}
+
+/**
+ * @brief   Sets the receive filter mode.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] mode      the new filter mode
+ *
+ * @notapi
+ */
+void mac_lld_set_filter_mode(MACDriver *macp, macfiltermode_t mode) {
+
+  (void)macp;
+
+  sim_filtermode = mode;
+}
+#endif /* MAC_USE_FILTERS */
+
+#if MAC_USE_ZERO_COPY || defined(__DOXYGEN__)
+/**
+ * @brief   Returns a pointer to the next transmit buffer in the descriptor
+ *          chain.
+ * @note    The API guarantees that enough buffers can be requested to fill
+ *          a whole frame.
+ *
+ * @param[in] tdp       pointer to a @p MACTransmitDescriptor structure
+ * @param[in] size      size of the requested buffer. Specify the frame size
+ *                      on the first call then scale the value down subtracting
+ *                      the amount of data already copied into the previous
+ *                      buffers.
+ * @param[out] sizep    pointer to variable receiving the real buffer size.
+ *                      The returned value can be less than the amount
+ *                      requested, this means that more buffers must be
+ *                      requested in order to fill the frame data entirely.
+ * @return              Pointer to the returned buffer.
+ * @retval NULL         if the buffer chain has been entirely scanned.
+ *
+ * @notapi
+ */
+uint8_t *mac_lld_get_next_transmit_buffer(MACTransmitDescriptor *tdp,
+                                          size_t size,
+                                          size_t *sizep) {
+
+  osalDbgAssert(tdp->physdesc->state == SIM_DESC_LOCKED,
+                "attempt to write descriptor already owned by DMA");
+
+  if (tdp->offset == 0U) {
+    *sizep      = tdp->size;
+    tdp->offset = size < tdp->size ? size : tdp->size;
+    return tdp->physdesc->buf;
+  }
+  *sizep = 0U;
+  return NULL;
+}
+
+/**
+ * @brief   Returns a pointer to the next receive buffer in the descriptor
+ *          chain.
+ * @note    The API guarantees that the descriptor chain contains a whole
+ *          frame.
+ *
+ * @param[in] rdp       pointer to a @p MACReceiveDescriptor structure
+ * @param[out] sizep    pointer to variable receiving the buffer size, it is
+ *                      zero when the last buffer has already been returned.
+ * @return              Pointer to the returned buffer.
+ * @retval NULL         if the buffer chain has been entirely scanned.
+ *
+ * @notapi
+ */
+const uint8_t *mac_lld_get_next_receive_buffer(MACReceiveDescriptor *rdp,
+                                               size_t *sizep) {
+
+  osalDbgAssert(rdp->physdesc->state == SIM_DESC_LOCKED,
+                "attempt to read descriptor already owned by DMA");
+
+  if (rdp->offset < rdp->size) {
+    *sizep      = rdp->size - rdp->offset;
+    rdp->offset = rdp->size;
+    return rdp->physdesc->buf + rdp->offset - *sizep;
+  }
+  *sizep = 0U;
+  return NULL;
+}
+#endif /* MAC_USE_ZERO_COPY */
+
+/**
+ * @brief   Forces the simulated link status.
+ * @details The new status is reported by the next link poll, it allows to
+ *          exercise the link down and up handling of the upper layers.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] up        @p false simulates an unplugged cable
+ *
+ * @api
+ */
+void mac_lld_set_link_status(MACDriver *macp, bool up) {
+
+  macp->link_enabled = up;
+}
+
+/**
+ * @brief   Reports the end of the replay file.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @return              The replay status.
+ * @retval true         if all the frames of the replay file have been
+ *                      received, never with the TAP backend or if the
+ *                      replay loops.
+ *
+ * @api
+ */
+bool mac_lld_replay_completed(MACDriver *macp) {
+
+  return macp->rxeof;
+}
+
+#endif /* HAL_USE_MAC */
+
+/** @} */
@@ -0,0 +1,336 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    simulator/posix/hal_mac_lld.h
+ * @brief   Posix simulator low level MAC driver header.
+ *
+ * @addtogroup POSIX_MAC
+ * @{
+ */
+
+#ifndef HAL_MAC_LLD_H
+#define HAL_MAC_LLD_H
+
+#if HAL_USE_MAC || defined(__DOXYGEN__)
+
+/*===========================================================================*/
+/* Driver constants.                                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   This implementation supports the zero-copy mode API.
+ */
+#define MAC_SUPPORTS_ZERO_COPY      TRUE
+
+/**
+ * @brief   This implementation supports the scatter-gather transmit API.
+ */
+#define MAC_SUPPORTS_SCATTER_GATHER TRUE
+
+/**
+ * @brief   This implementation supports the hardware receive filters API.
+ */
+#define MAC_SUPPORTS_FILTERS        TRUE
+
+/**
+ * @brief   This implementation supports the hardware statistics API.
+ */
+#define MAC_SUPPORTS_STATISTICS     TRUE
+
+/**
+ * @brief   This implementation supports hardware timestamping.
+ */
+#define MAC_SUPPORTS_TIMESTAMPS     TRUE
+
+/**
+ * @brief   This implementation supports the rings occupancy statistics API.
+ */
+#define MAC_SUPPORTS_RING_STATISTICS TRUE
+
+/**
+ * @name    Simulated network backends
+ * @{
+ */
+#define SIM_MAC_BACKEND_TAP         0   /**< Linux TAP interface.           */
+#define SIM_MAC_BACKEND_PCAP        1   /**< Replay and capture files.      */
+/** @} */
+
+/*===========================================================================*/
+/* Driver pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @name    Configuration options
+ * @{
+ */
+/**
+ * @brief   Network backend.
+ * @details With @p SIM_MAC_BACKEND_TAP frames are exchanged with the host
+ *          through a TAP interface, with @p SIM_MAC_BACKEND_PCAP received
+ *          frames are replayed from a pcap file and transmitted frames are
+ *          written into another pcap file.
+ */
+#if !defined(SIM_MAC_BACKEND) || defined(__DOXYGEN__)
+#define SIM_MAC_BACKEND                     SIM_MAC_BACKEND_TAP
+#endif
+
+/**
+ * @brief   Name of the TAP interface.
+ * @note    The interface must exist and be accessible by the simulator
+ *          user, for example created with
+ *          <tt>ip tuntap add dev tap0 mode tap user $USER</tt>.
+ */
+#if !defined(SIM_MAC_TAP_NAME) || defined(__DOXYGEN__)
+#define SIM_MAC_TAP_NAME                    "tap0"
+#endif
+
+/**
+ * @brief   Pcap file replayed as received frames.
+ * @note    Only used by @p SIM_MAC_BACKEND_PCAP.
+ */
+#if !defined(SIM_MAC_PCAP_INPUT) || defined(__DOXYGEN__)
+#define SIM_MAC_PCAP_INPUT                  "rx.pcap"
+#endif
+
+/**
+ * @brief   Pcap file capturing the transmitted frames.
+ * @details If set to @p NULL the transmitted frames are not captured,
+ *          it can be used with both backends.
+ */
+#if !defined(SIM_MAC_PCAP_OUTPUT) || defined(__DOXYGEN__)
+#define SIM_MAC_PCAP_OUTPUT                 NULL
+#endif
+
+/**
+ * @brief   Replays the input file again when its end is reached.
+ */
+#if !defined(SIM_MAC_PCAP_LOOP) || defined(__DOXYGEN__)
+#define SIM_MAC_PCAP_LOOP                   FALSE
+#endif
+
+/**
+ * @brief   Number of simulated transmit descriptors.
+ */
+#if !defined(SIM_MAC_TRANSMIT_BUFFERS) || defined(__DOXYGEN__)
+#define SIM_MAC_TRANSMIT_BUFFERS            4
+#endif
+
+/**
+ * @brief   Number of simulated receive descriptors.
+ * @details Frames arriving from the TAP interface while all the receive
+ *          descriptors are in use are dropped and counted as missed,
+ *          replayed frames wait for a descriptor instead.
+ */
+#if !defined(SIM_MAC_RECEIVE_BUFFERS) || defined(__DOXYGEN__)
+#define SIM_MAC_RECEIVE_BUFFERS             4
+#endif
+
+/**
+ * @brief   Maximum supported frame size.
+ */
+#if !defined(SIM_MAC_BUFFERS_SIZE) || defined(__DOXYGEN__)
+#define SIM_MAC_BUFFERS_SIZE                1524
+#endif
+
+/**
+ * @brief   Number of multicast addresses in the receive filter.
+ * @details When all the entries are in use all multicast frames are
+ *          accepted.
+ */
+#if !defined(SIM_MAC_MULTICAST_ADDRESSES) || defined(__DOXYGEN__)
+#define SIM_MAC_MULTICAST_ADDRESSES         8
+#endif
+/** @} */
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/**
+ * @brief   Maximum number of buffers composing a scatter-gather frame.
+ */
+#define MAC_MAX_FRAME_BUFFERS       16
+
+#if (SIM_MAC_BACKEND != SIM_MAC_BACKEND_TAP) &&                             \
+    (SIM_MAC_BACKEND != SIM_MAC_BACKEND_PCAP)
+#error "invalid SIM_MAC_BACKEND value"
+#endif
+
+#if (SIM_MAC_BACKEND == SIM_MAC_BACKEND_TAP) && !defined(__linux__)
+#error "SIM_MAC_BACKEND_TAP is only supported on Linux"
+#endif
+
+#if SIM_MAC_TRANSMIT_BUFFERS < 1
+#error "invalid SIM_MAC_TRANSMIT_BUFFERS value"
+#endif
+
+#if SIM_MAC_RECEIVE_BUFFERS < 1
+#error "invalid SIM_MAC_RECEIVE_BUFFERS value"
+#endif
+
+#if SIM_MAC_BUFFERS_SIZE < 64
+#error "invalid SIM_MAC_BUFFERS_SIZE value"
+#endif
+
+/*===========================================================================*/
+/* Driver data structures and types.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Type of a simulated descriptor.
+ */
+typedef struct {
+  /**
+   * @brief   Descriptor state.
+   */
+  volatile uint32_t     state;
+  /**
+   * @brief   Frame size.
+   */
+  size_t                size;
+  /**
+   * @brief   Scatter-gather frame cookie.
+   */
+  void                  *cookie;
+  /**
+   * @brief   Transmission or reception timestamp.
+   */
+  mactimestamp_t        ts;
+  /**
+   * @brief   Frame buffer.
+   */
+  uint8_t               buf[SIM_MAC_BUFFERS_SIZE];
+} sim_mac_descriptor_t;
+
+/*===========================================================================*/
+/* Driver macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @brief   Low level fields of the MAC driver structure.
+ */
+#define mac_lld_driver_fields                                               \
+  /* Link status flag.*/                                                    \
+  bool                          link_up;                                    \
+  /* Link status forced by the application.*/                               \
+  bool                          link_enabled;                               \
+  /* Backend file descriptor or -1.*/                                       \
+  int                           fd;                                         \
+  /* Replay file or NULL.*/                                                 \
+  FILE                          *rxfile;                                    \
+  /* Capture file or NULL.*/                                                \
+  FILE                          *txfile;                                    \
+  /* Replay file with nanosecond timestamps.*/                              \
+  bool                          rxnsec;                                     \
+  /* Replay file with swapped byte order.*/                                 \
+  bool                          rxswapped;                                  \
+  /* Replay file completed.*/                                               \
+  bool                          rxeof;                                      \
+  /* Served receive interrupts.*/                                           \
+  uint32_t                      rxirqs;                                     \
+  /* Received frames.*/                                                     \
+  uint32_t                      rxframes;
+
+/**
+ * @brief   Low level fields of the MAC configuration structure.
+ */
+#define mac_lld_config_fields                                               \
+  /* MAC address.*/                                                         \
+  uint8_t                       *mac_address;
+
+/**
+ * @brief   Low level fields of the MAC transmit descriptor structure.
+ */
+#define mac_lld_transmit_descriptor_fields                                  \
+  /* Pointer to the simulated descriptor.*/                                 \
+  sim_mac_descriptor_t          *physdesc;
+
+/**
+ * @brief   Low level fields of the MAC receive descriptor structure.
+ */
+#define mac_lld_receive_descriptor_fields                                   \
+  /* Pointer to the simulated descriptor.*/                                 \
+  sim_mac_descriptor_t          *physdesc;
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#if !defined(__DOXYGEN__)
+extern MACDriver ETHD1;
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void mac_lld_init(void);
+  void mac_lld_start(MACDriver *macp);
+  void mac_lld_stop(MACDriver *macp);
+  msg_t mac_lld_get_transmit_descriptor(MACDriver *macp,
+                                        MACTransmitDescriptor *tdp);
+  void mac_lld_release_transmit_descriptor(MACTransmitDescriptor *tdp);
+  msg_t mac_lld_get_receive_descriptor(MACDriver *macp,
+                                       MACReceiveDescriptor *rdp);
+  void mac_lld_release_receive_descriptor(MACReceiveDescriptor *rdp);
+  bool mac_lld_poll_link_status(MACDriver *macp);
+  size_t mac_lld_write_transmit_descriptor(MACTransmitDescriptor *tdp,
+                                           uint8_t *buf,
+                                           size_t size);
+  size_t mac_lld_read_receive_descriptor(MACReceiveDescriptor *rdp,
+                                         uint8_t *buf,
+                                         size_t size);
+#if MAC_USE_ZERO_COPY
+  uint8_t *mac_lld_get_next_transmit_buffer(MACTransmitDescriptor *tdp,
+                                            size_t size,
+                                            size_t *sizep);
+  const uint8_t *mac_lld_get_next_receive_buffer(MACReceiveDescriptor *rdp,
+                                                 size_t *sizep);
+#endif /* MAC_USE_ZERO_COPY */
+#if MAC_USE_SCATTER_GATHER
+  msg_t mac_lld_transmit_buffers(MACDriver *macp, const macbuffer_t *bp,
+                                 size_t n, void *cookie);
+  void *mac_lld_reclaim_transmit_buffers(MACDriver *macp,
+                                         mactimestamp_t *tsp);
+#endif /* MAC_USE_SCATTER_GATHER */
+#if MAC_USE_TIMESTAMPS
+  void mac_lld_get_timestamp(MACDriver *macp, mactimestamp_t *tsp);
+#endif /* MAC_USE_TIMESTAMPS */
+#if MAC_USE_STATISTICS
+  void mac_lld_get_statistics(MACDriver *macp, macstatistics_t *sp);
+#endif /* MAC_USE_STATISTICS */
+#if MAC_USE_RING_STATISTICS
+  void mac_lld_get_ring_statistics(MACDriver *macp,
+                                   macringstatistics_t *rsp);
+#endif /* MAC_USE_RING_STATISTICS */
+#if MAC_USE_FILTERS
+  void mac_lld_add_multicast_address(MACDriver *macp, const uint8_t *addr);
+  msg_t mac_lld_remove_multicast_address(MACDriver *macp,
+                                         const uint8_t *addr);
+  void mac_lld_set_filter_mode(MACDriver *macp, macfiltermode_t mode);
+#endif /* MAC_USE_FILTERS */
+  void mac_lld_set_link_status(MACDriver *macp, bool up);
+  bool mac_lld_replay_completed(MACDriver *macp);
+  bool mac_lld_interrupt_pending(void);
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HAL_USE_MAC */
+
+#endif /* HAL_MAC_LLD_H */
+
+/** @} */
@@ -245,6 +245,248 @@ msg_t macWaitReceiveDescriptor(MACDriver *macp,
   return msg;
 }
 
+#if (MAC_USE_SCATTER_GATHER == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Transmits a frame composed of multiple buffers.
+ * @details The frame is enqueued for transmission without copying the
+ *          buffers, if there are not enough descriptors available then the
+ *          invoking thread is queued until some are freed.
+ * @note    The buffers must not be modified or freed until the frame cookie
+ *          is returned by @p macReclaimTransmitBuffers().
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] bp        pointer to an array of @p macbuffer_t structures
+ * @param[in] n         number of buffers in the array, it cannot exceed
+ *                      @p MAC_MAX_FRAME_BUFFERS
+ * @param[in] cookie    frame identifier, it must not be @p NULL
+ * @param[in] timeout   the number of ticks before the operation timeouts,
+ *                      the following special values are allowed:
+ *                      - @a TIME_IMMEDIATE immediate timeout.
+ *                      - @a TIME_INFINITE no timeout.
+ * @return              The operation status.
+ * @retval MSG_OK       the frame has been enqueued.
+ * @retval MSG_TIMEOUT  the operation timed out, frame not enqueued.
+ * @retval MSG_RESET    the buffers are not accessible by the DMA, the frame
+ *                      must be copied.
+ *
+ * @api
+ */
+msg_t macTransmitBuffers(MACDriver *macp, const macbuffer_t *bp, size_t n,
+                         void *cookie, sysinterval_t timeout) {
+  msg_t msg;
+
+  osalDbgCheck((macp != NULL) && (bp != NULL) &&
+               (n > 0U) && (n <= MAC_MAX_FRAME_BUFFERS) && (cookie != NULL));
+  osalDbgAssert(macp->state == MAC_ACTIVE, "not active");
+
+  osalSysLock();
+
+  while ((msg = macTransmitBuffersI(macp, bp, n, cookie)) == MSG_TIMEOUT) {
+    msg = osalThreadEnqueueTimeoutS(&macp->tdqueue, timeout);
+    if (msg == MSG_TIMEOUT) {
+      break;
+    }
+  }
+
+  osalSysUnlock();
+
+  return msg;
+}
+
+/**
+ * @brief   Returns the cookie of a transmitted frame.
+ * @details The buffers of the returned frame can be reused or freed.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] tsp      pointer to the transmission timestamp of the frame,
+ *                      can be @p NULL
+ * @return              The cookie of a frame whose transmission has been
+ *                      completed.
+ * @retval NULL         if there are no more completed frames.
+ *
+ * @api
+ */
+void *macReclaimTransmitBuffers(MACDriver *macp, mactimestamp_t *tsp) {
+  void *cookie;
+
+  osalDbgCheck(macp != NULL);
+
+  osalSysLock();
+  cookie = macReclaimTransmitBuffersI(macp, tsp);
+  osalOsRescheduleS();
+  osalSysUnlock();
+
+  return cookie;
+}
+#endif /* MAC_USE_SCATTER_GATHER == TRUE */
+
+#if (MAC_USE_STATISTICS == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the MAC statistics.
+ * @details The hardware counters are collected and accumulated, the
+ *          function should be called periodically in order to prevent
+ *          the hardware counters from wrapping.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] sp       pointer to the statistics to be filled
+ *
+ * @api
+ */
+void macGetStatistics(MACDriver *macp, macstatistics_t *sp) {
+
+  osalDbgCheck((macp != NULL) && (sp != NULL));
+
+  osalSysLock();
+  mac_lld_get_statistics(macp, sp);
+  osalSysUnlock();
+}
+#endif /* MAC_USE_STATISTICS == TRUE */
+
+#if (MAC_USE_RING_STATISTICS == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the descriptor rings occupancy statistics.
+ * @details The rings are sampled before returning the statistics, the time
+ *          spent full includes the current interval.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[out] rsp      pointer to the statistics to be filled
+ *
+ * @api
+ */
+void macGetRingStatistics(MACDriver *macp, macringstatistics_t *rsp) {
+
+  osalDbgCheck((macp != NULL) && (rsp != NULL));
+
+  osalSysLock();
+  mac_lld_get_ring_statistics(macp, rsp);
+  osalSysUnlock();
+}
+#endif /* MAC_USE_RING_STATISTICS == TRUE */
+
+/**
+ * @brief   Initializes an occupancy statistics object.
+ *
+ * @param[out] op       pointer to the @p macoccupancy_t object
+ * @param[in] size      number of entries of the ring or pool
+ *
+ * @init
+ */
+void macOccupancyObjectInit(macoccupancy_t *op, uint32_t size) {
+  unsigned i;
+
+  osalDbgCheck((op != NULL) && (size > 0U));
+
+  op->size        = size;
+  op->used        = 0U;
+  op->high_water  = 0U;
+  op->full_events = 0U;
+  op->full_time   = 0U;
+  op->last        = osalOsGetSystemTimeX();
+  for (i = 0U; i < MAC_OCCUPANCY_BINS; i++) {
+    op->histogram[i] = 0U;
+  }
+}
+
+/**
+ * @brief   Records an occupancy sample.
+ * @details The interval since the previous sample is accounted as time
+ *          spent full if all the entries were in use.
+ * @note    The caller must make sure that the object is not accessed
+ *          concurrently, usually by holding the system lock.
+ *
+ * @param[in] op        pointer to the @p macoccupancy_t object
+ * @param[in] used      number of entries currently in use
+ *
+ * @xclass
+ */
+void macOccupancySampleX(macoccupancy_t *op, uint32_t used) {
+  systime_t now = osalOsGetSystemTimeX();
+  unsigned bin;
+
+  if (op->used >= op->size) {
+    op->full_time += (uint64_t)osalTimeDiffX(op->last, now);
+  }
+  else if (used >= op->size) {
+    op->full_events++;
+  }
+  op->last = now;
+  op->used = used;
+
+  if (used > op->high_water) {
+    op->high_water = used;
+  }
+  if (used >= op->size) {
+    bin = MAC_OCCUPANCY_BINS - 1U;
+  }
+  else {
+    bin = (unsigned)((used * (MAC_OCCUPANCY_BINS - 1U)) / op->size);
+  }
+  op->histogram[bin]++;
+}
+
+#if (MAC_USE_FILTERS == TRUE) || defined(__DOXYGEN__)
+/**
+ * @brief   Adds a multicast address to the receive filters.
+ * @details Frames addressed to the specified address are accepted, the
+ *          address is reference counted so it can be added more than once.
+ * @note    The filters are retained across @p macStop() and @p macStart().
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] addr      pointer to a six bytes multicast address
+ *
+ * @api
+ */
+void macAddMulticastAddress(MACDriver *macp, const uint8_t *addr) {
+
+  osalDbgCheck((macp != NULL) && (addr != NULL));
+  osalDbgAssert((addr[0] & 1U) != 0U, "not a multicast address");
+
+  osalSysLock();
+  mac_lld_add_multicast_address(macp, addr);
+  osalSysUnlock();
+}
+
+/**
+ * @brief   Removes a multicast address from the receive filters.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] addr      pointer to a six bytes multicast address
+ * @return              The operation status.
+ * @retval MSG_OK       the address has been removed.
+ * @retval MSG_RESET    the address was not registered.
+ *
+ * @api
+ */
+msg_t macRemoveMulticastAddress(MACDriver *macp, const uint8_t *addr) {
+  msg_t msg;
+
+  osalDbgCheck((macp != NULL) && (addr != NULL));
+
+  osalSysLock();
+  msg = mac_lld_remove_multicast_address(macp, addr);
+  osalSysUnlock();
+
+  return msg;
+}
+
+/**
+ * @brief   Sets the receive filter mode.
+ *
+ * @param[in] macp      pointer to the @p MACDriver object
+ * @param[in] mode      the new filter mode
+ *
+ * @api
+ */
+void macSetFilterMode(MACDriver *macp, macfiltermode_t mode) {
+
+  osalDbgCheck(macp != NULL);
+
+  osalSysLock();
+  mac_lld_set_filter_mode(macp, mode);
+  osalSysUnlock();
+}
+#endif /* MAC_USE_FILTERS == TRUE */
+
 /**
  * @brief   Updates and returns the link status.
  *
@@ -78,6 +78,105 @@
 #define LWIP_PLATFORM_ASSERT(x)     osalSysHalt(x)
 #endif
 
+/**
+ * @brief   Checks the core locking rules when the ChibiOS assertions are
+ *          enabled.
+ * @details The lwIP core must be locked by the caller if
+ *          @p LWIP_TCPIP_CORE_LOCKING is enabled, else it must only be
+ *          accessed by the tcpip thread.
+ */
+#if !defined(LWIP_ASSERT_CORE_LOCKED) && (CH_DBG_ENABLE_ASSERTS == TRUE)
+#define LWIP_ASSERT_CORE_LOCKED()   sys_check_core_locking()
+#define LWIP_MARK_TCPIP_THREAD()    sys_mark_tcpip_thread()
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void sys_check_core_locking(void);
+  void sys_mark_tcpip_thread(void);
+#ifdef __cplusplus
+}
+#endif
+#endif
+
+/**
+ * @brief   IPv4 input hook of lwipthread when the MAC verifies the received
+ *          checksums.
+ * @details The MAC does not verify the transport checksum of IP fragments,
+ *          the hook reassembles them and verifies the checksum of the
+ *          datagram. An application defining its own hook has to do the
+ *          same.
+ */
+#if !defined(LWIP_HOOK_IP4_INPUT) && defined(MAC_OFFLOADS_RX_CHECKSUM)
+#if MAC_OFFLOADS_RX_CHECKSUM
+#define LWIP_HOOK_IP4_INPUT(p, inp) lwip_ip4_input_hook(p, inp)
+#ifdef __cplusplus
+extern "C" {
+#endif
+  struct pbuf;
+  struct netif;
+  int lwip_ip4_input_hook(struct pbuf *p, struct netif *inp);
+#ifdef __cplusplus
+}
+#endif
+#endif
+#endif
+
+/**
+ * @brief   tcpip thread loop hook of lwipthread.
+ * @details Called after each message or timeout handled by the tcpip thread,
+ *          lwipthread posts again there the received frames that did not
+ *          fit the tcpip mailbox.
+ */
+#if !defined(LWIP_TCPIP_THREAD_ALIVE)
+#define LWIP_TCPIP_THREAD_ALIVE()   lwip_tcpip_thread_alive()
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void lwip_tcpip_thread_alive(void);
+#ifdef __cplusplus
+}
+#endif
+#endif
+
+/**
+ * @brief   Use the optimized checksum routines by default.
+ * @details The Internet checksum sums 32 bytes per iteration through an
+ *          add-with-carry chain on ARMv7-M, 32 bits words elsewhere, and
+ *          is fused with the copy when @p LWIP_CHECKSUM_ON_COPY is enabled.
+ */
+#if !defined(CH_LWIP_USE_ARCH_CHKSUM)
+#define CH_LWIP_USE_ARCH_CHKSUM     TRUE
+#endif
+
+/**
+ * @brief   Checksum microbenchmark against the lwIP generic routine.
+ * @note    Requires @p LWIP_CHKSUM_ALGORITHM in order to build the generic
+ *          routine.
+ */
+#if !defined(CH_LWIP_CHKSUM_BENCHMARK)
+#define CH_LWIP_CHKSUM_BENCHMARK    FALSE
+#endif
+
+#if CH_LWIP_USE_ARCH_CHKSUM
+#if !defined(LWIP_CHKSUM)
+#define LWIP_CHKSUM                 lwip_arch_chksum
+#endif
+#if !defined(LWIP_CHKSUM_COPY)
+#define LWIP_CHKSUM_COPY(dst, src, len) lwip_arch_chksum_copy(dst, src, len)
+#endif
+#ifdef __cplusplus
+extern "C" {
+#endif
+  uint16_t lwip_arch_chksum(const void *dataptr, int len);
+  uint16_t lwip_arch_chksum_copy(void *dst, const void *src, uint16_t len);
+#if CH_LWIP_CHKSUM_BENCHMARK
+  void lwip_arch_chksum_benchmark(BaseSequentialStream *chp);
+#endif
+#ifdef __cplusplus
+}
+#endif
+#endif
+
 /**
  * @brief   The NETIF API is required by lwipthread.
  */
@@ -0,0 +1,355 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/*
+ * Internet checksum for the lwIP LWIP_CHKSUM and LWIP_CHKSUM_COPY hooks.
+ *
+ * The words are summed 32 bits at a time, on ARMv7-M through a chain of
+ * add-with-carry instructions consuming 32 bytes per iteration, the carry
+ * out of each addition is folded back by the next one. The results are
+ * the same as lwip_standard_chksum(): non-inverted sums, in the byte order
+ * of the data, of buffers starting at any address.
+ *
+ * The copy variant sums the words while moving them when source and
+ * destination share the same alignment, the head and tail bytes are
+ * summed apart and the partial sums of the pieces starting at odd offsets
+ * are byte swapped before being combined.
+ */
+
+#include <string.h>
+
+#include "hal.h"
+
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/inet_chksum.h"
+
+#include "arch/cc.h"
+
+#if CH_LWIP_USE_ARCH_CHKSUM
+
+#if CH_LWIP_CHKSUM_BENCHMARK
+#include "chprintf.h"
+#endif
+
+#if defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_7M__)
+// 32 bytes blocks, word aligned, the carry stays in the flags across the
+// iterations because TEQ does not alter it, it is folded at the end
+static uint32_t chksum_blocks(const uint32_t *src, size_t n, uint32_t sum) {
+  const uint32_t *end = src + n * 8U;
+  uint32_t a, b, c, d;
+
+  __asm__ (
+    "   adds    %[s], %[s], #0          \n"
+    "1:                                 \n"
+    "   ldrd    %[a], %[b], [%[p]], #8  \n"
+    "   ldrd    %[c], %[d], [%[p]], #8  \n"
+    "   adcs    %[s], %[s], %[a]        \n"
+    "   adcs    %[s], %[s], %[b]        \n"
+    "   adcs    %[s], %[s], %[c]        \n"
+    "   adcs    %[s], %[s], %[d]        \n"
+    "   ldrd    %[a], %[b], [%[p]], #8  \n"
+    "   ldrd    %[c], %[d], [%[p]], #8  \n"
+    "   adcs    %[s], %[s], %[a]        \n"
+    "   adcs    %[s], %[s], %[b]        \n"
+    "   adcs    %[s], %[s], %[c]        \n"
+    "   adcs    %[s], %[s], %[d]        \n"
+    "   teq     %[p], %[e]              \n"
+    "   bne     1b                      \n"
+    "   adcs    %[s], %[s], #0          \n"
+    "   adc     %[s], %[s], #0          \n"
+    : [s] "+r" (sum), [p] "+r" (src),
+      [a] "=&r" (a), [b] "=&r" (b), [c] "=&r" (c), [d] "=&r" (d)
+    : [e] "r" (end)
+    : "cc", "memory");
+
+  return sum;
+}
+
+static uint32_t chksum_copy_blocks(uint32_t *dst, const uint32_t *src,
+                                   size_t n, uint32_t sum) {
+  const uint32_t *end = src + n * 8U;
+  uint32_t a, b, c, d;
+
+  __asm__ (
+    "   adds    %[s], %[s], #0          \n"
+    "1:                                 \n"
+    "   ldrd    %[a], %[b], [%[p]], #8  \n"
+    "   ldrd    %[c], %[d], [%[p]], #8  \n"
+    "   strd    %[a], %[b], [%[q]], #8  \n"
+    "   strd    %[c], %[d], [%[q]], #8  \n"
+    "   adcs    %[s], %[s], %[a]        \n"
+    "   adcs    %[s], %[s], %[b]        \n"
+    "   adcs    %[s], %[s], %[c]        \n"
+    "   adcs    %[s], %[s], %[d]        \n"
+    "   ldrd    %[a], %[b], [%[p]], #8  \n"
+    "   ldrd    %[c], %[d], [%[p]], #8  \n"
+    "   strd    %[a], %[b], [%[q]], #8  \n"
+    "   strd    %[c], %[d], [%[q]], #8  \n"
+    "   adcs    %[s], %[s], %[a]        \n"
+    "   adcs    %[s], %[s], %[b]        \n"
+    "   adcs    %[s], %[s], %[c]        \n"
+    "   adcs    %[s], %[s], %[d]        \n"
+    "   teq     %[p], %[e]              \n"
+    "   bne     1b                      \n"
+    "   adcs    %[s], %[s], #0          \n"
+    "   adc     %[s], %[s], #0          \n"
+    : [s] "+r" (sum), [p] "+r" (src), [q] "+r" (dst),
+      [a] "=&r" (a), [b] "=&r" (b), [c] "=&r" (c), [d] "=&r" (d)
+    : [e] "r" (end)
+    : "cc", "memory");
+
+  return sum;
+}
+#else
+static uint32_t chksum_blocks(const uint32_t *src, size_t n, uint32_t sum) {
+  uint64_t acc = sum;
+
+  do {
+    acc += (uint64_t)src[0] + src[1] + src[2] + src[3];
+    acc += (uint64_t)src[4] + src[5] + src[6] + src[7];
+    src += 8;
+  } while (--n > 0U);
+  acc = (acc >> 32) + (acc & 0xFFFFFFFFU);
+  acc = (acc >> 32) + (acc & 0xFFFFFFFFU);
+
+  return (uint32_t)acc;
+}
+
+static uint32_t chksum_copy_blocks(uint32_t *dst, const uint32_t *src,
+                                   size_t n, uint32_t sum) {
+  uint64_t acc = sum;
+
+  do {
+    unsigned i;
+
+    for (i = 0U; i < 8U; i++) {
+      dst[i] = src[i];
+      acc += src[i];
+    }
+    dst += 8;
+    src += 8;
+  } while (--n > 0U);
+  acc = (acc >> 32) + (acc & 0xFFFFFFFFU);
+  acc = (acc >> 32) + (acc & 0xFFFFFFFFU);
+
+  return (uint32_t)acc;
+}
+#endif
+
+static uint32_t chksum_add(uint32_t sum, uint32_t w) {
+
+  sum += w;
+  return sum + (sum < w ? 1U : 0U);
+}
+
+static uint16_t chksum_fold(uint32_t sum) {
+
+  sum = FOLD_U32T(sum);
+  sum = FOLD_U32T(sum);
+  return (uint16_t)sum;
+}
+
+// word aligned data, optionally copied, len multiple of 4
+static uint32_t chksum_words(uint32_t *dst, const uint32_t *src, size_t len) {
+  uint32_t sum = 0U;
+  size_t n = len / 32U;
+
+  if (n > 0U) {
+    if (dst != NULL) {
+      sum = chksum_copy_blocks(dst, src, n, sum);
+      dst += n * 8U;
+    }
+    else
+      sum = chksum_blocks(src, n, sum);
+    src += n * 8U;
+  }
+  for (len &= 31U; len > 0U; len -= 4U) {
+    if (dst != NULL)
+      *dst++ = *src;
+    sum = chksum_add(sum, *src++);
+  }
+
+  return sum;
+}
+
+u16_t lwip_arch_chksum(const void *dataptr, int len) {
+  const u8_t *pb = (const u8_t *)dataptr;
+  u16_t t = 0U;
+  uint32_t sum = 0U;
+  bool odd = ((mem_ptr_t)pb & 1U) != 0U;
+
+  // pairing from an even address, the sum is swapped back at the end
+  if (odd && (len > 0)) {
+    ((u8_t *)&t)[1] = *pb++;
+    len--;
+  }
+  if ((((mem_ptr_t)pb & 2U) != 0U) && (len > 1)) {
+    sum = *(const u16_t *)(const void *)pb;
+    pb += 2;
+    len -= 2;
+  }
+  if (len > 3) {
+    sum = chksum_add(sum, chksum_words(NULL, (const uint32_t *)(const void *)pb,
+                                       (size_t)len & ~(size_t)3U));
+    pb += len & ~3;
+    len &= 3;
+  }
+  if (len > 1) {
+    sum = chksum_add(sum, *(const u16_t *)(const void *)pb);
+    pb += 2;
+    len -= 2;
+  }
+  if (len > 0)
+    ((u8_t *)&t)[0] = *pb;
+  sum = chksum_fold(chksum_add(sum, t));
+  if (odd)
+    sum = SWAP_BYTES_IN_WORD(sum);
+
+  return (u16_t)sum;
+}
+
+u16_t lwip_arch_chksum_copy(void *dst, const void *src, u16_t len) {
+  u8_t *pd = (u8_t *)dst;
+  const u8_t *ps = (const u8_t *)src;
+  size_t head, body;
+  uint32_t sum;
+  u16_t part;
+
+  if ((((mem_ptr_t)pd ^ (mem_ptr_t)ps) & 3U) != 0U) {
+    // misaligned to each other, two passes
+    MEMCPY(dst, src, len);
+    return lwip_arch_chksum(dst, len);
+  }
+
+  head = (4U - ((mem_ptr_t)ps & 3U)) & 3U;
+  if (head > len)
+    head = len;
+  body = (len - head) & ~(size_t)3U;
+
+  memcpy(pd, ps, head);
+  sum = lwip_arch_chksum(ps, (int)head);
+
+  part = chksum_fold(chksum_words((uint32_t *)(void *)(pd + head),
+                                  (const uint32_t *)(const void *)(ps + head),
+                                  body));
+  sum += (head & 1U) != 0U ? (u16_t)SWAP_BYTES_IN_WORD(part) : part;
+
+  pd += head + body;
+  ps += head + body;
+  memcpy(pd, ps, len - head - body);
+  part = lwip_arch_chksum(ps, (int)(len - head - body));
+  sum += (head & 1U) != 0U ? (u16_t)SWAP_BYTES_IN_WORD(part) : part;
+
+  return chksum_fold(sum);
+}
+
+#if CH_LWIP_CHKSUM_BENCHMARK
+#if !CH_CFG_USE_TM
+#error "CH_LWIP_CHKSUM_BENCHMARK requires CH_CFG_USE_TM"
+#endif
+
+// the lwIP generic checksum, built with LWIP_CHKSUM_ALGORITHM
+u16_t lwip_standard_chksum(const void *dataptr, int len);
+
+#define BENCH_MAX_SIZE      1472
+#define BENCH_RUNS          32
+
+static uint32_t bench_src[BENCH_MAX_SIZE / 4 + 1];
+static uint32_t bench_dst[BENCH_MAX_SIZE / 4 + 1];
+
+typedef u16_t (*bench_fn_t)(unsigned off, int len);
+
+static u16_t bench_generic(unsigned off, int len) {
+
+  return lwip_standard_chksum((u8_t *)bench_src + off, len);
+}
+
+static u16_t bench_arch(unsigned off, int len) {
+
+  return lwip_arch_chksum((u8_t *)bench_src + off, len);
+}
+
+static u16_t bench_copy_generic(unsigned off, int len) {
+
+  memcpy((u8_t *)bench_dst + off, (u8_t *)bench_src + off, (size_t)len);
+  return lwip_standard_chksum((u8_t *)bench_dst + off, len);
+}
+
+static u16_t bench_copy_arch(unsigned off, int len) {
+
+  return lwip_arch_chksum_copy((u8_t *)bench_dst + off,
+                               (u8_t *)bench_src + off, (u16_t)len);
+}
+
+// best of the runs, in realtime counter cycles
+static rtcnt_t bench_run(bench_fn_t fn, unsigned off, int len, u16_t *resp) {
+  time_measurement_t tm;
+  unsigned i;
+
+  chTMObjectInit(&tm);
+  for (i = 0U; i < BENCH_RUNS; i++) {
+    chTMStartMeasurementX(&tm);
+    *resp = fn(off, len);
+    chTMStopMeasurementX(&tm);
+  }
+
+  return tm.best;
+}
+
+/**
+ * @brief   Compares the checksum routines with the lwIP generic ones.
+ * @details Prints, for several lengths and alignments, the best time in
+ *          realtime counter cycles of the generic checksum, of the
+ *          optimized checksum and of the copies followed or fused with the
+ *          checksum, a mismatch between the results is flagged.
+ *
+ * @param[in] chp       pointer to the output stream
+ *
+ * @api
+ */
+void lwip_arch_chksum_benchmark(BaseSequentialStream *chp) {
+  static const int sizes[] = {20, 64, 256, 576, 1024, 1460};
+  uint32_t seed = 0x12345678U;
+  unsigned i, off;
+
+  for (i = 0U; i < sizeof bench_src / sizeof bench_src[0]; i++) {
+    seed = seed * 1664525U + 1013904223U;
+    bench_src[i] = seed;
+  }
+
+  chprintf(chp, "chksum len+off: generic arch copy+generic copy (cycles)\n");
+  for (off = 0U; off < 4U; off++) {
+    for (i = 0U; i < sizeof sizes / sizeof sizes[0]; i++) {
+      u16_t r1, r2, r3, r4;
+      rtcnt_t t1, t2, t3, t4;
+      int len = sizes[i];
+
+      if (off + (unsigned)len > BENCH_MAX_SIZE)
+        len = (int)(BENCH_MAX_SIZE - off);
+      t1 = bench_run(bench_generic, off, len, &r1);
+      t2 = bench_run(bench_arch, off, len, &r2);
+      t3 = bench_run(bench_copy_generic, off, len, &r3);
+      t4 = bench_run(bench_copy_arch, off, len, &r4);
+      chprintf(chp, "%4d+%u: %6u %6u %6u %6u%s\n", len, off,
+               (unsigned)t1, (unsigned)t2, (unsigned)t3, (unsigned)t4,
+               ((r2 != r1) || (r3 != r1) || (r4 != r1)) ? " MISMATCH" : "");
+    }
+  }
+}
+#endif
+
+#endif /* CH_LWIP_USE_ARCH_CHKSUM */
@@ -52,29 +52,276 @@
  * See http://lwip.wikia.com/wiki/Porting_for_an_OS for instructions.
  */
 
+#include <string.h>
+
 #include "hal.h"
+#include "monoclock.h"
 
 #include "lwip/opt.h"
 #include "lwip/mem.h"
 #include "lwip/sys.h"
 #include "lwip/stats.h"
+#include "lwip/tcpip.h"
+#include "lwip/timeouts.h"
+#include "lwip/priv/tcpip_priv.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/etharp.h"
+#include "lwip/ip4_frag.h"
+#include "lwip/igmp.h"
 
 #include "arch/cc.h"
 #include "arch/sys_arch.h"
 #include "lwipopts.h"
 
-#ifndef CH_LWIP_USE_MEM_POOLS 
-#define CH_LWIP_USE_MEM_POOLS FALSE
+#if CH_LWIP_MBOX_MEASURE && !CH_CFG_USE_TM
+#error "CH_LWIP_MBOX_MEASURE requires CH_CFG_USE_TM"
+#endif
+
+#if CH_LWIP_USE_LOCKFREE_MBOX
+// bounded ring after D. Vyukov, a slot sequence equal to the position
+// means free for the producer reserving it, position + 1 means filled
+typedef struct {
+  uint32_t      seq;
+  void          *msg;
+} sys_mbox_slot_t;
+
+struct sys_lfmbox {
+  uint32_t            tail;         // next position, reserved by CAS
+  uint32_t            head;         // next position, owned by the consumer
+  uint32_t            mask;
+  uint32_t            waiting;      // consumer waiting on notempty
+  uint32_t            full_waiters; // producers waiting on notfull
+  binary_semaphore_t  notempty;
+  semaphore_t         notfull;
+  sys_mbox_slot_t     *slots;
+};
+
+typedef struct sys_lfmbox sys_mbox_impl_t;
+#else
+typedef mailbox_t sys_mbox_impl_t;
+#endif
+
+#if CH_LWIP_MBOX_MEASURE
+static sys_arch_mbox_stats_t lwip_sys_arch_mbox_stats = {
+  .post = {.best = (rtcnt_t)-1},
+  .fetch = {.best = (rtcnt_t)-1}
+};
+
+static void sys_mbox_measure_i(time_measurement_t *tmp, rtcnt_t start) {
+
+  tmp->last = chSysGetRealtimeCounterX() - start;
+  tmp->n++;
+  tmp->cumulative += (rttime_t)tmp->last;
+  if (tmp->last > tmp->worst)
+    tmp->worst = tmp->last;
+  if (tmp->last < tmp->best)
+    tmp->best = tmp->last;
+}
+
+static void sys_mbox_measure(time_measurement_t *tmp, rtcnt_t start) {
+
+  chSysLock();
+  sys_mbox_measure_i(tmp, start);
+  chSysUnlock();
+}
+
+#define MBOX_STATS_INC(field) do {                                          \
+  chSysLock();                                                              \
+  lwip_sys_arch_mbox_stats.field++;                                         \
+  chSysUnlock();                                                            \
+} while (false)
+#else
+#define MBOX_STATS_INC(field)
+#endif
+
+#if CH_LWIP_USE_LOCKFREE_MBOX
+static uint32_t sys_mbox_ring_size(int size) {
+  uint32_t n = 1U;
+
+  while (n < (uint32_t)size)
+    n <<= 1;
+  return n;
+}
+
+// storage following the mailbox object
+static size_t sys_mbox_storage(int size) {
+
+  return sizeof(sys_mbox_slot_t) * sys_mbox_ring_size(size);
+}
+
+static void sys_mbox_init(sys_mbox_impl_t *mbp, void *buf, int size) {
+  uint32_t i;
+
+  mbp->tail = 0U;
+  mbp->head = 0U;
+  mbp->mask = sys_mbox_ring_size(size) - 1U;
+  mbp->waiting = 0U;
+  mbp->full_waiters = 0U;
+  chBSemObjectInit(&mbp->notempty, true);
+  chSemObjectInit(&mbp->notfull, (cnt_t)0);
+  mbp->slots = buf;
+  for (i = 0U; i <= mbp->mask; i++)
+    mbp->slots[i].seq = i;
+}
+
+// any producer, ISRs included, never blocks
+static bool sys_mbox_put(sys_mbox_impl_t *mbp, void *msg, bool fromisr) {
+  uint32_t pos = __atomic_load_n(&mbp->tail, __ATOMIC_RELAXED);
+  sys_mbox_slot_t *sp;
+
+  while (true) {
+    int32_t diff;
+
+    sp = &mbp->slots[pos & mbp->mask];
+    diff = (int32_t)(__atomic_load_n(&sp->seq, __ATOMIC_ACQUIRE) - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&mbp->tail, &pos, pos + 1U, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    }
+    else if (diff < 0)
+      return false;
+    else
+      pos = __atomic_load_n(&mbp->tail, __ATOMIC_RELAXED);
+  }
+  sp->msg = msg;
+  __atomic_store_n(&sp->seq, pos + 1U, __ATOMIC_RELEASE);
+
+  // either the consumer sees the message before sleeping or it is seen
+  // sleeping here
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if ((__atomic_load_n(&mbp->waiting, __ATOMIC_RELAXED) != 0U) &&
+      (__atomic_exchange_n(&mbp->waiting, 0U, __ATOMIC_RELAXED) != 0U)) {
+    if (fromisr) {
+      chSysLockFromISR();
+#if CH_LWIP_MBOX_MEASURE
+      lwip_sys_arch_mbox_stats.wakeups++;
+#endif
+      chBSemSignalI(&mbp->notempty);
+      chSysUnlockFromISR();
+    }
+    else {
+      MBOX_STATS_INC(wakeups);
+      chBSemSignal(&mbp->notempty);
+    }
+  }
+  return true;
+}
+
+// consumer only, never blocks
+static bool sys_mbox_get(sys_mbox_impl_t *mbp, void **msgp) {
+  sys_mbox_slot_t *sp = &mbp->slots[mbp->head & mbp->mask];
+
+  if (__atomic_load_n(&sp->seq, __ATOMIC_ACQUIRE) != mbp->head + 1U)
+    return false;
+  if (msgp != NULL)
+    *msgp = sp->msg;
+  __atomic_store_n(&sp->seq, mbp->head + mbp->mask + 1U, __ATOMIC_RELEASE);
+  mbp->head++;
+
+  // same handshake as above with the producers waiting for a free slot,
+  // a stale signal only costs them a retry
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&mbp->full_waiters, __ATOMIC_RELAXED) != 0U)
+    chSemSignal(&mbp->notfull);
+  return true;
+}
+#else
+static size_t sys_mbox_storage(int size) {
+
+  return sizeof(msg_t) * (size_t)size;
+}
+
+static void sys_mbox_init(sys_mbox_impl_t *mbp, void *buf, int size) {
+
+  chMBObjectInit(mbp, buf, size);
+}
 #endif
 
 #if CH_LWIP_USE_MEM_POOLS 
 static MEMORYPOOL_DECL(lwip_sys_arch_sem_pool, sizeof(semaphore_t), 4, chCoreAllocAlignedI);
-static MEMORYPOOL_DECL(lwip_sys_arch_mbox_pool, sizeof(mailbox_t) + sizeof(msg_t) * TCPIP_MBOX_SIZE, 4, chCoreAllocAlignedI);
-static MEMORYPOOL_DECL(lwip_sys_arch_thread_pool, THD_WORKING_AREA_SIZE(TCPIP_THREAD_STACKSIZE), PORT_WORKING_AREA_ALIGN, chCoreAllocAlignedI);
+static MEMORYPOOL_DECL(lwip_sys_arch_mutex_pool, sizeof(mutex_t), 4, chCoreAllocAlignedI);
+
+// mailboxes and thread stacks come from the pool of the smallest size
+// class fitting the request, or of a larger class if it cannot grow, the
+// pools are fed by the core allocator and a class grows up to its peak
+// usage without fragmenting the heap
+typedef struct {
+  memory_pool_t           pool;
+  sys_arch_class_stats_t  stats;
+} sys_class_t;
+
+// the class is remembered for sys_mbox_free(), the messages follow
+typedef struct {
+  sys_mbox_impl_t mb;
+  unsigned        cls;
+} sys_mbox_obj_t;
+
+// class sizes in ascending order, checked here, a class as large as the
+// previous one is never chosen first and only serves as a fallback
+#if (DEFAULT_ACCEPTMBOX_SIZE > TCPIP_MBOX_SIZE) ||                         \
+    (TCPIP_MBOX_SIZE > DEFAULT_TCP_RECVMBOX_SIZE)
+#error "mailbox size classes not in ascending order"
+#endif
+#if (DEFAULT_RAW_RECVMBOX_SIZE > DEFAULT_TCP_RECVMBOX_SIZE) ||             \
+    (DEFAULT_UDP_RECVMBOX_SIZE > DEFAULT_TCP_RECVMBOX_SIZE)
+#error "raw and UDP receive mailboxes larger than every size class"
+#endif
+#if DEFAULT_THREAD_STACKSIZE > TCPIP_THREAD_STACKSIZE
+#error "thread stack size classes not in ascending order"
+#endif
+
+static sys_class_t lwip_sys_arch_mbox_classes[SYS_ARCH_MBOX_CLASSES] = {
+  {.stats = {.size = DEFAULT_ACCEPTMBOX_SIZE}},
+  {.stats = {.size = TCPIP_MBOX_SIZE}},
+  {.stats = {.size = DEFAULT_TCP_RECVMBOX_SIZE}}
+};
+static sys_class_t lwip_sys_arch_thread_classes[SYS_ARCH_THREAD_CLASSES] = {
+  {.stats = {.size = DEFAULT_THREAD_STACKSIZE}},
+  {.stats = {.size = TCPIP_THREAD_STACKSIZE}}
+};
+
+// first class fitting a size, n if none
+static unsigned sys_class_find(const sys_class_t *cp, unsigned n,
+                               size_t size) {
+  unsigned i;
+
+  for (i = 0U; (i < n) && (cp[i].stats.size < size); i++) {
+  }
+  return i;
+}
+
+static void sys_class_count_used_i(sys_class_t *cp) {
+
+  cp->stats.used++;
+  if (cp->stats.used > cp->stats.max)
+    cp->stats.max = cp->stats.used;
+}
 #endif
 
 void sys_init(void) {
+#if CH_LWIP_USE_MEM_POOLS
+  unsigned i;
+#endif
+
+  mclkInit();
+
+#if CH_LWIP_USE_MEM_POOLS
+  for (i = 0U; i < SYS_ARCH_MBOX_CLASSES; i++) {
+    sys_class_t *cp = &lwip_sys_arch_mbox_classes[i];
+
+    chPoolObjectInitAligned(&cp->pool, sizeof(sys_mbox_obj_t) +
+                                       sys_mbox_storage((int)cp->stats.size),
+                            PORT_NATURAL_ALIGN, chCoreAllocAlignedI);
+  }
+
+  for (i = 0U; i < SYS_ARCH_THREAD_CLASSES; i++) {
+    sys_class_t *cp = &lwip_sys_arch_thread_classes[i];
 
+    chPoolObjectInitAligned(&cp->pool, THD_WORKING_AREA_SIZE(cp->stats.size),
+                            PORT_WORKING_AREA_ALIGN, chCoreAllocAlignedI);
+  }
+#endif
 }
 
 err_t sys_sem_new(sys_sem_t *sem, u8_t count) {
@@ -146,25 +393,107 @@ void sys_sem_set_invalid(sys_sem_t *sem) {
   *sem = SYS_SEM_NULL;
 }
 
+err_t sys_mutex_new(sys_mutex_t *mutex) {
+
+#if !CH_LWIP_USE_MEM_POOLS
+  *mutex = chHeapAlloc(NULL, sizeof(mutex_t));
+#else
+  *mutex = chPoolAlloc(&lwip_sys_arch_mutex_pool);
+#endif
+
+  if (*mutex == 0) {
+    SYS_STATS_INC(mutex.err);
+    return ERR_MEM;
+  }
+  else {
+    chMtxObjectInit(*mutex);
+    SYS_STATS_INC_USED(mutex);
+    return ERR_OK;
+  }
+}
+
+void sys_mutex_free(sys_mutex_t *mutex) {
+
+#if !CH_LWIP_USE_MEM_POOLS
+  chHeapFree(*mutex);
+#else
+  chPoolFree(&lwip_sys_arch_mutex_pool, *mutex);
+#endif
+  *mutex = SYS_MUTEX_NULL;
+  SYS_STATS_DEC(mutex.used);
+}
+
+// the owner priority is raised while higher priority threads are waiting,
+// the core lock does not delay them behind medium priority threads
+void sys_mutex_lock(sys_mutex_t *mutex) {
+
+  chMtxLock(*mutex);
+}
+
+void sys_mutex_unlock(sys_mutex_t *mutex) {
+
+  chMtxUnlock(*mutex);
+}
+
+int sys_mutex_valid(sys_mutex_t *mutex) {
+  return *mutex != SYS_MUTEX_NULL;
+}
+
+void sys_mutex_set_invalid(sys_mutex_t *mutex) {
+  *mutex = SYS_MUTEX_NULL;
+}
+
 err_t sys_mbox_new(sys_mbox_t *mbox, int size) {
 
 #if !CH_LWIP_USE_MEM_POOLS
-  *mbox = chHeapAlloc(NULL, sizeof(mailbox_t) + sizeof(msg_t) * size);
+  *mbox = chHeapAlloc(NULL, sizeof(sys_mbox_impl_t) + sys_mbox_storage(size));
+  if (*mbox != 0)
+    sys_mbox_init(*mbox, (void *)(*mbox + 1), size);
 #else
-  *mbox = chPoolAlloc(&lwip_sys_arch_mbox_pool);
+  sys_class_t *cp = lwip_sys_arch_mbox_classes;
+  unsigned n = SYS_ARCH_MBOX_CLASSES;
+  unsigned i, first = sys_class_find(cp, n, (size_t)size);
+  sys_mbox_obj_t *objp = NULL;
+
+  chDbgAssert(first < n, "no mailbox size class");
+
+  chSysLock();
+  for (i = first; (i < n) && (objp == NULL); i++) {
+    objp = chPoolAllocI(&cp[i].pool);
+    if (objp != NULL) {
+      objp->cls = i;
+      sys_class_count_used_i(&cp[i]);
+    }
+  }
+  if ((objp == NULL) && (first < n))
+    cp[first].stats.err++;
+  chSysUnlock();
+
+  *mbox = (sys_mbox_t)objp;
+  if (objp != NULL)
+    sys_mbox_init(&objp->mb, (void *)(objp + 1), size);
 #endif
   if (*mbox == 0) {
     SYS_STATS_INC(mbox.err);
     return ERR_MEM;
   }
   else {
-    chMBObjectInit(*mbox, (void *)(((uint8_t *)*mbox) + sizeof(mailbox_t)), size);
-    SYS_STATS_INC(mbox.used);
+    SYS_STATS_INC_USED(mbox);
     return ERR_OK;
   }
 }
 
 void sys_mbox_free(sys_mbox_t *mbox) {
+#if CH_LWIP_USE_LOCKFREE_MBOX
+  sys_mbox_impl_t *mbp = *mbox;
+
+  if (__atomic_load_n(&mbp->tail, __ATOMIC_ACQUIRE) != mbp->head) {
+    // If there are messages still present in the mailbox when the mailbox
+    // is deallocated, it is an indication of a programming error in lwIP
+    // and the developer should be notified.
+    SYS_STATS_INC(mbox.err);
+  }
+#else
   cnt_t tmpcnt;
 
   chSysLock();
@@ -178,48 +507,162 @@ void sys_mbox_free(sys_mbox_t *mbox) {
     SYS_STATS_INC(mbox.err);
     chMBReset(*mbox);
   }
+#endif
 #if !CH_LWIP_USE_MEM_POOLS
   chHeapFree(*mbox);
 #else
-  chPoolFree(&lwip_sys_arch_mbox_pool, *mbox);
+  {
+    sys_class_t *cp = &lwip_sys_arch_mbox_classes[((sys_mbox_obj_t *)*mbox)->cls];
+
+    chSysLock();
+    chPoolFreeI(&cp->pool, *mbox);
+    cp->stats.used--;
+    chSysUnlock();
+  }
 #endif
   *mbox = SYS_MBOX_NULL;
   SYS_STATS_DEC(mbox.used);
 }
 
 void sys_mbox_post(sys_mbox_t *mbox, void *msg) {
+#if CH_LWIP_MBOX_MEASURE
+  rtcnt_t start = chSysGetRealtimeCounterX();
+#endif
+
+#if CH_LWIP_USE_LOCKFREE_MBOX
+  sys_mbox_impl_t *mbp = *mbox;
 
+  if (!sys_mbox_put(mbp, msg, false)) {
+    MBOX_STATS_INC(full);
+    __atomic_add_fetch(&mbp->full_waiters, 1U, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    while (!sys_mbox_put(mbp, msg, false))
+      chSemWait(&mbp->notfull);
+    __atomic_sub_fetch(&mbp->full_waiters, 1U, __ATOMIC_RELAXED);
+  }
+#else
   chMBPostTimeout(*mbox, (msg_t)msg, TIME_INFINITE);
+#endif
+#if CH_LWIP_MBOX_MEASURE
+  sys_mbox_measure(&lwip_sys_arch_mbox_stats.post, start);
+#endif
 }
 
 err_t sys_mbox_trypost(sys_mbox_t *mbox, void *msg) {
+#if CH_LWIP_MBOX_MEASURE
+  rtcnt_t start = chSysGetRealtimeCounterX();
+#endif
 
+#if CH_LWIP_USE_LOCKFREE_MBOX
+  if (!sys_mbox_put(*mbox, msg, false)) {
+#else
   if (chMBPostTimeout(*mbox, (msg_t)msg, TIME_IMMEDIATE) == MSG_TIMEOUT) {
+#endif
+    MBOX_STATS_INC(full);
     SYS_STATS_INC(mbox.err);
     return ERR_MEM;
   }
+#if CH_LWIP_MBOX_MEASURE
+  sys_mbox_measure(&lwip_sys_arch_mbox_stats.post, start);
+#endif
   return ERR_OK;
 }
 
+err_t sys_mbox_trypost_fromisr(sys_mbox_t *mbox, void *msg) {
+  msg_t msgsts;
+
+#if CH_LWIP_USE_LOCKFREE_MBOX
+  msgsts = sys_mbox_put(*mbox, msg, true) ? MSG_OK : MSG_TIMEOUT;
+  chSysLockFromISR();
+#else
+  chSysLockFromISR();
+  msgsts = chMBPostI(*mbox, (msg_t)msg);
+#endif
+  if (msgsts != MSG_OK) {
+#if CH_LWIP_MBOX_MEASURE
+    lwip_sys_arch_mbox_stats.full++;
+#endif
+    SYS_STATS_INC(mbox.err);
+  }
+  chSysUnlockFromISR();
+  return msgsts == MSG_OK ? ERR_OK : ERR_MEM;
+}
+
 u32_t sys_arch_mbox_fetch(sys_mbox_t *mbox, void **msg, u32_t timeout) {
   systime_t start;
   sysinterval_t tmo, remaining;
+#if CH_LWIP_MBOX_MEASURE
+  rtcnt_t mstart = chSysGetRealtimeCounterX();
+#endif
+
+#if CH_LWIP_USE_LOCKFREE_MBOX
+  sys_mbox_impl_t *mbp = *mbox;
 
+  tmo = timeout > 0 ? TIME_MS2I((time_msecs_t)timeout) : TIME_INFINITE;
+  start = chVTGetSystemTimeX();
+  if (sys_mbox_get(mbp, msg)) {
+#if CH_LWIP_MBOX_MEASURE
+    sys_mbox_measure(&lwip_sys_arch_mbox_stats.fetch, mstart);
+#endif
+    return 0;
+  }
+  while (true) {
+    msg_t msgsts;
+
+    // announce the wait, then check again for a message posted meanwhile
+    __atomic_store_n(&mbp->waiting, 1U, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (sys_mbox_get(mbp, msg))
+      break;
+    remaining = tmo;
+    if (tmo != TIME_INFINITE) {
+      sysinterval_t elapsed = chTimeDiffX(start, chVTGetSystemTimeX());
+
+      if (elapsed >= tmo)
+        remaining = TIME_IMMEDIATE;
+      else
+        remaining = tmo - elapsed;
+    }
+    msgsts = chBSemWaitTimeout(&mbp->notempty, remaining);
+    if (msgsts != MSG_OK) {
+      __atomic_store_n(&mbp->waiting, 0U, __ATOMIC_RELAXED);
+      if (sys_mbox_get(mbp, msg))
+        break;
+      return SYS_ARCH_TIMEOUT;
+    }
+  }
+  __atomic_store_n(&mbp->waiting, 0U, __ATOMIC_RELAXED);
+  remaining = chTimeDiffX(start, chVTGetSystemTimeX());
+#else
   chSysLock();
   tmo = timeout > 0 ? TIME_MS2I((time_msecs_t)timeout) : TIME_INFINITE;
   start = chVTGetSystemTimeX();
+#if CH_LWIP_MBOX_MEASURE
+  if (chMBGetUsedCountI(*mbox) > (cnt_t)0) {
+    (void) chMBFetchI(*mbox, (msg_t *)msg);
+    sys_mbox_measure_i(&lwip_sys_arch_mbox_stats.fetch, mstart);
+    chSchRescheduleS();
+    chSysUnlock();
+    return 0;
+  }
+#endif
   if (chMBFetchTimeoutS(*mbox, (msg_t *)msg, tmo) != MSG_OK) {
     chSysUnlock();
     return SYS_ARCH_TIMEOUT;
   }
   remaining = chTimeDiffX(start, chVTGetSystemTimeX());
   chSysUnlock();
+#endif
   return (u32_t)TIME_I2MS(remaining);
 }
 
 u32_t sys_arch_mbox_tryfetch(sys_mbox_t *mbox, void **msg) {
 
+#if CH_LWIP_USE_LOCKFREE_MBOX
+  if (!sys_mbox_get(*mbox, msg))
+#else
   if (chMBFetchTimeout(*mbox, (msg_t *)msg, TIME_IMMEDIATE) == MSG_TIMEOUT)
+#endif
     return SYS_MBOX_EMPTY;
   return 0;
 }
@@ -242,13 +685,75 @@ sys_thread_t sys_thread_new(const char *name, lwip_thread_fn thread,
   tp = chThdCreateFromHeap(NULL, THD_WORKING_AREA_SIZE(stacksize),
                            name, prio, (tfunc_t)thread, arg);
 #else
-  (void) stacksize;
-  tp = chThdCreateFromMemoryPool(&lwip_sys_arch_thread_pool, name,
-                            prio, (tfunc_t)thread, arg);
+  sys_class_t *cp = lwip_sys_arch_thread_classes;
+  unsigned n = SYS_ARCH_THREAD_CLASSES;
+  unsigned i, first = sys_class_find(cp, n, (size_t)stacksize);
+
+  chDbgAssert(first < n, "no thread stack size class");
+
+  tp = NULL;
+  for (i = first; (i < n) && (tp == NULL); i++) {
+    tp = chThdCreateFromMemoryPool(&cp[i].pool, name,
+                                   prio, (tfunc_t)thread, arg);
+  }
+  chSysLock();
+  if (tp != NULL)
+    sys_class_count_used_i(&cp[i - 1U]);
+  else if (first < n)
+    cp[first].stats.err++;
+  chSysUnlock();
 #endif
   return (sys_thread_t)tp;
 }
 
+#if CH_LWIP_MBOX_MEASURE
+void sys_arch_get_mbox_stats(sys_arch_mbox_stats_t *sp) {
+
+  chSysLock();
+  *sp = lwip_sys_arch_mbox_stats;
+  chSysUnlock();
+}
+#endif
+
+#if CH_LWIP_USE_MEM_POOLS
+void sys_arch_get_pool_stats(sys_arch_pool_stats_t *sp) {
+  unsigned i;
+
+  chSysLock();
+  for (i = 0U; i < SYS_ARCH_MBOX_CLASSES; i++)
+    sp->mbox[i] = lwip_sys_arch_mbox_classes[i].stats;
+  for (i = 0U; i < SYS_ARCH_THREAD_CLASSES; i++)
+    sp->thread[i] = lwip_sys_arch_thread_classes[i].stats;
+  chSysUnlock();
+}
+#endif
+
+#if (CH_DBG_ENABLE_ASSERTS == TRUE) && !defined(__DOXYGEN__)
+static thread_t *tcpip_tp;
+
+void sys_mark_tcpip_thread(void) {
+
+  tcpip_tp = chThdGetSelfX();
+}
+
+// the checks start when the core lock exists or the tcpip thread runs,
+// lwip_init() sets the first timeouts before
+void sys_check_core_locking(void) {
+
+  chDbgAssert(!port_is_isr_context(), "called from ISR");
+#if LWIP_TCPIP_CORE_LOCKING
+  if (lock_tcpip_core != SYS_MUTEX_NULL) {
+    chDbgAssert(lock_tcpip_core->owner == chThdGetSelfX(),
+                "core not locked");
+  }
+#else
+  if (tcpip_tp != NULL) {
+    chDbgAssert(tcpip_tp == chThdGetSelfX(), "not the tcpip thread");
+  }
+#endif
+}
+#endif
+
 sys_prot_t sys_arch_protect(void) {
 
   return chSysGetStatusAndLockX();
@@ -267,26 +772,216 @@ void sys_arch_unprotect(sys_prot_t pval) {
 u32_t sys_now(void) {return (u32_t)osalOsGetSystemTimeX();}
 
 #else
+// derived from the monotonic clock, exact at any system tick frequency and
+// consistent with the microseconds time stamps of the application
 u32_t sys_now(void) {
-  static struct {
-    systime_t   last_system_time;
-    u32_t       last_ms;
-    u32_t       last_unprocessed;
-  } persistent = {0, 0, 0};
-  u32_t delta;
-  systime_t now_time;
 
-  /* Calculating delta, in ticks, from the last acquired system time.*/
-  now_time = osalOsGetSystemTimeX();
-  delta = (u32_t)osalTimeDiffX(persistent.last_system_time, now_time) +
-          persistent.last_unprocessed;
-  persistent.last_system_time = now_time;
+  return (u32_t)MCLK_US2MS(mclkGetMicrosecondsX());
+}
+#endif
+
+#if LWIP_TIMERS && LWIP_TIMERS_CUSTOM
+/*
+ * lwIP timeouts driven by virtual timers, the tcpip thread is only woken
+ * by a timer with work to do instead of waking on the nearest timeout.
+ * The timer callbacks post static callback messages, a message still
+ * queued is not posted again.
+ */
+typedef struct {
+  virtual_timer_t                 vt;
+  struct tcpip_msg                msg;
+  const struct lwip_cyclic_timer  *ctp;
+  volatile bool                   posted;
+} sys_cyclic_t;
+
+typedef struct {
+  virtual_timer_t                 vt;
+  struct tcpip_msg                msg;
+  sys_timeout_handler             h;
+  void                            *arg;
+  volatile bool                   posted;
+} sys_timeout_t;
+
+static sys_cyclic_t *sys_cyclics;
+static sys_timeout_t sys_timeouts[CH_LWIP_SYS_TIMEOUTS];
+
+static void sys_msg_init(struct tcpip_msg *msgp, tcpip_callback_fn fn,
+                         void *ctx) {
+
+  msgp->type = TCPIP_MSG_CALLBACK_STATIC;
+  msgp->msg.cb.function = fn;
+  msgp->msg.cb.ctx = ctx;
+}
 
-  /* Storing this milliseconds time and eventual remainder.*/
-  persistent.last_ms          += delta / (OSAL_ST_FREQUENCY / 1000U);
-  persistent.last_unprocessed  = delta % (OSAL_ST_FREQUENCY / 1000U);
+static bool sys_msg_post_fromisr(struct tcpip_msg *msgp) {
 
-  return persistent.last_ms;
+  return tcpip_callbackmsg_trycallback_fromisr(
+             (struct tcpip_callback_msg *)msgp) == ERR_OK;
 }
+
+static void sys_cyclic_run(void *ctx) {
+  sys_cyclic_t *cp = ctx;
+
+  cp->posted = false;
+  cp->ctp->handler();
+}
+
+// timers whose tables are empty have no work, the tables are read
+// without locking from the timer callback
+static bool sys_cyclic_idle(const struct lwip_cyclic_timer *ctp) {
+
+#if LWIP_TCP
+  // active or time-wait pcbs, the lists heads are read atomically
+  if (ctp->handler == tcp_tmr)
+    return (tcp_active_pcbs == NULL) && (tcp_tw_pcbs == NULL);
+#endif
+#if LWIP_IPV4 && IP_REASSEMBLY
+  // datagrams being reassembled
+  if (ctp->handler == ip_reass_tmr)
+    return ip_reass_tmr_pending() == 0U;
 #endif
+#if LWIP_IPV4 && LWIP_ARP
+  // ARP entries aged, static ones excluded
+  if (ctp->handler == etharp_tmr)
+    return etharp_tmr_pending() == 0U;
+#endif
+#if LWIP_IPV4 && LWIP_IGMP
+  // groups with a delayed report
+  if (ctp->handler == igmp_tmr)
+    return igmp_tmr_pending() == 0U;
+#endif
+  return false;
+}
+
+static void sys_cyclic_cb(virtual_timer_t *vtp, void *p) {
+  sys_cyclic_t *cp = p;
+
+  (void)vtp;
+
+  if (cp->posted || sys_cyclic_idle(cp->ctp))
+    return;
+  // on a full tcpip mailbox this period is skipped
+  cp->posted = true;
+  if (!sys_msg_post_fromisr(&cp->msg))
+    cp->posted = false;
+}
+
+static void sys_timeout_run(void *ctx) {
+  sys_timeout_t *tp = ctx;
+  sys_timeout_handler h = tp->h;
+
+  // the slot is free again before the handler, which can rearm it
+  tp->h = NULL;
+  tp->posted = false;
+  if (h != NULL)
+    h(tp->arg);
+}
 
+static void sys_timeout_cb(virtual_timer_t *vtp, void *p) {
+  sys_timeout_t *tp = p;
+
+  tp->posted = true;
+  if (!sys_msg_post_fromisr(&tp->msg)) {
+    // retry on the next tick, a timeout must not be lost
+    tp->posted = false;
+    chSysLockFromISR();
+    chVTDoSetI(vtp, (sysinterval_t)1, sys_timeout_cb, p);
+    chSysUnlockFromISR();
+  }
+}
+
+static sysinterval_t sys_ms2i(u32_t msecs) {
+  sysinterval_t delay = chTimeMS2I((time_msecs_t)msecs);
+
+  return delay > (sysinterval_t)0 ? delay : (sysinterval_t)1;
+}
+
+// called from lwip_init(), the first expiry happens after the creation of
+// the tcpip mailbox in tcpip_init()
+void sys_timeouts_init(void) {
+  int i;
+
+  sys_cyclics = chCoreAllocAligned(sizeof(sys_cyclic_t) *
+                                   (size_t)lwip_num_cyclic_timers,
+                                   PORT_NATURAL_ALIGN);
+  osalDbgAssert(sys_cyclics != NULL, "out of memory");
+
+  for (i = 0; i < CH_LWIP_SYS_TIMEOUTS; i++) {
+    chVTObjectInit(&sys_timeouts[i].vt);
+    sys_msg_init(&sys_timeouts[i].msg, sys_timeout_run, &sys_timeouts[i]);
+    sys_timeouts[i].h = NULL;
+    sys_timeouts[i].posted = false;
+  }
+
+  for (i = 0; i < lwip_num_cyclic_timers; i++) {
+    sys_cyclic_t *cp = &sys_cyclics[i];
+
+    chVTObjectInit(&cp->vt);
+    sys_msg_init(&cp->msg, sys_cyclic_run, cp);
+    cp->ctp = &lwip_cyclic_timers[i];
+    cp->posted = false;
+    chVTSetContinuous(&cp->vt, sys_ms2i(cp->ctp->interval_ms),
+                      sys_cyclic_cb, cp);
+  }
+}
+
+#if LWIP_DEBUG_TIMERNAMES
+void sys_timeout_debug(u32_t msecs, sys_timeout_handler handler, void *arg,
+                       const char *handler_name) {
+#else
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg) {
+#endif
+  sys_timeout_t *tp;
+
+  LWIP_ASSERT_CORE_LOCKED();
+#if LWIP_DEBUG_TIMERNAMES
+  (void)handler_name;
+#endif
+
+  chSysLock();
+  for (tp = &sys_timeouts[0]; tp < &sys_timeouts[CH_LWIP_SYS_TIMEOUTS]; tp++) {
+    if ((tp->h == NULL) && !tp->posted)
+      break;
+  }
+  if (tp >= &sys_timeouts[CH_LWIP_SYS_TIMEOUTS]) {
+    chSysUnlock();
+    LWIP_ASSERT("sys_timeout: out of timeouts, see CH_LWIP_SYS_TIMEOUTS", 0);
+    return;
+  }
+  tp->h = handler;
+  tp->arg = arg;
+  chVTSetI(&tp->vt, sys_ms2i(msecs), sys_timeout_cb, tp);
+  chSysUnlock();
+}
+
+void sys_untimeout(sys_timeout_handler handler, void *arg) {
+  sys_timeout_t *tp;
+
+  LWIP_ASSERT_CORE_LOCKED();
+
+  chSysLock();
+  for (tp = &sys_timeouts[0]; tp < &sys_timeouts[CH_LWIP_SYS_TIMEOUTS]; tp++) {
+    if ((tp->h == handler) && (tp->arg == arg)) {
+      // a message already posted finds the slot cleared and does nothing
+      chVTResetI(&tp->vt);
+      tp->h = NULL;
+      break;
+    }
+  }
+  chSysUnlock();
+}
+
+void sys_restart_timeouts(void) {
+
+}
+
+void sys_check_timeouts(void) {
+
+}
+
+// the tcpip thread waits for messages only
+u32_t sys_timeouts_sleeptime(void) {
+
+  return SYS_TIMEOUTS_SLEEPTIME_INFINITE;
+}
+#endif
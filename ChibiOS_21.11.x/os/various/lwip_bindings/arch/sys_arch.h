@@ -53,16 +53,103 @@
 #ifndef __SYS_ARCH_H__
 #define __SYS_ARCH_H__
 
+/* Lock-free mailboxes, the producers post without entering the kernel
+   and the consumer is woken through a binary semaphore only when it is
+   waiting on an empty mailbox. Every mailbox must have a single consumer,
+   which is the case for the tcpip mailbox and for sockets and netconns
+   not read by several threads at once.*/
+#ifndef CH_LWIP_USE_LOCKFREE_MBOX
+#define CH_LWIP_USE_LOCKFREE_MBOX FALSE
+#endif
+
+/* One-shot sys_timeout() timeouts available at once, used with
+   LWIP_TIMERS_CUSTOM where the lwIP timers are virtual timers.*/
+#ifndef CH_LWIP_SYS_TIMEOUTS
+#define CH_LWIP_SYS_TIMEOUTS 4
+#endif
+
+/* Measurement of the mailbox operations, requires CH_CFG_USE_TM.*/
+#ifndef CH_LWIP_MBOX_MEASURE
+#define CH_LWIP_MBOX_MEASURE FALSE
+#endif
+
 typedef semaphore_t *   sys_sem_t;
+typedef mutex_t *       sys_mutex_t;
+#if CH_LWIP_USE_LOCKFREE_MBOX
+typedef struct sys_lfmbox * sys_mbox_t;
+#else
 typedef mailbox_t *     sys_mbox_t;
+#endif
 typedef thread_t *      sys_thread_t;
 typedef syssts_t        sys_prot_t;
 
+#if CH_LWIP_USE_LOCKFREE_MBOX
+#define SYS_MBOX_NULL   (struct sys_lfmbox *)0
+#else
 #define SYS_MBOX_NULL   (mailbox_t *)0
+#endif
 #define SYS_THREAD_NULL (thread_t *)0
 #define SYS_SEM_NULL    (semaphore_t *)0
+#define SYS_MUTEX_NULL  (mutex_t *)0
+
+/* ChibiOS mutexes, with priority inheritance, are used for the lwIP
+   mutexes and the core lock.*/
+#define LWIP_COMPAT_MUTEX 0
+
+#ifndef CH_LWIP_USE_MEM_POOLS
+#define CH_LWIP_USE_MEM_POOLS FALSE
+#endif
+
+#if CH_LWIP_USE_MEM_POOLS
+/* Mailbox size classes in ascending order: accept, raw and UDP receive,
+   tcpip, TCP receive.*/
+#define SYS_ARCH_MBOX_CLASSES   3
+
+/* Thread stack size classes in ascending order: default, tcpip.*/
+#define SYS_ARCH_THREAD_CLASSES 2
+
+/* Usage counters of a size class. The size is in messages for the
+   mailboxes and in bytes of stack for the threads. Threads are only
+   counted when created.*/
+typedef struct {
+  size_t        size;
+  uint32_t      used;
+  uint32_t      max;
+  uint32_t      err;
+} sys_arch_class_stats_t;
+
+typedef struct {
+  sys_arch_class_stats_t mbox[SYS_ARCH_MBOX_CLASSES];
+  sys_arch_class_stats_t thread[SYS_ARCH_THREAD_CLASSES];
+} sys_arch_pool_stats_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void sys_arch_get_pool_stats(sys_arch_pool_stats_t *sp);
+#ifdef __cplusplus
+}
+#endif
+#endif
+
+#if CH_LWIP_MBOX_MEASURE
+/* Realtime counter cycles spent posting, including the wakeup of a
+   waiting consumer, and fetching a message already queued. The critical
+   sections time is given by the kernel statistics (CH_DBG_STATISTICS).*/
+typedef struct {
+  time_measurement_t    post;
+  time_measurement_t    fetch;
+  uint32_t              wakeups;
+  uint32_t              full;
+} sys_arch_mbox_stats_t;
 
-/* let sys.h use binary semaphores for mutexes */
-#define LWIP_COMPAT_MUTEX 1
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void sys_arch_get_mbox_stats(sys_arch_mbox_stats_t *sp);
+#ifdef __cplusplus
+}
+#endif
+#endif
 
 #endif /* __SYS_ARCH_H__ */
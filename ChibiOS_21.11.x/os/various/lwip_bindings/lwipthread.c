@@ -55,11 +55,18 @@
  * @{
  */
 
+#include <string.h>
+
 #include "hal.h"
 #include "evtimer.h"
+#include "monoclock.h"
 
 #include "lwipthread.h"
 
+#if LWIP_OCCUPANCY_STATS || LWIP_MAC_TX_STRESS_TEST
+#include "chprintf.h"
+#endif
+
 #include <lwip/opt.h>
 #include <lwip/def.h>
 #include <lwip/mem.h>
@@ -69,7 +76,16 @@
 #include <lwip/snmp.h>
 #include <lwip/tcpip.h>
 #include <netif/etharp.h>
+#include <netif/ethernet.h>
 #include <lwip/netifapi.h>
+#include <lwip/api.h>
+#include <lwip/inet_chksum.h>
+#include <lwip/ip.h>
+#include <lwip/ip4_frag.h>
+#include <lwip/prot/ip4.h>
+#include <lwip/prot/udp.h>
+#include <lwip/prot/tcp.h>
+#include <lwip/prot/icmp.h>
 
 #if LWIP_DHCP
 #include <lwip/dhcp.h>
@@ -81,6 +97,124 @@
 
 #define PERIODIC_TIMER_ID       1
 #define FRAME_RECEIVED_ID       2
+#define FRAME_TRANSMITTED_ID    4
+#define LINK_EVENT_ID           8
+
+#if MAC_USE_ZERO_COPY && ETH_PAD_SIZE
+#error "ETH_PAD_SIZE not supported in zero-copy mode"
+#endif
+
+#if MAC_USE_SCATTER_GATHER && ETH_PAD_SIZE
+#error "ETH_PAD_SIZE not supported in scatter-gather mode"
+#endif
+
+#if MAC_USE_SCATTER_GATHER && !SYS_LIGHTWEIGHT_PROT
+#error "scatter-gather mode requires SYS_LIGHTWEIGHT_PROT"
+#endif
+
+#if LWIP_RX_POLL_BUDGET < 1
+#error "invalid LWIP_RX_POLL_BUDGET value"
+#endif
+
+#if MAC_USE_ZERO_COPY && (LWIP_MAC_RX_PBUFS_LOW_WATER >= LWIP_MAC_RX_PBUFS)
+#error "invalid LWIP_MAC_RX_PBUFS_LOW_WATER value"
+#endif
+
+#if LWIP_RX_BATCH_SIZE < 0
+#error "invalid LWIP_RX_BATCH_SIZE value"
+#endif
+
+/*
+ * With the core lock the received frames are processed inline by the
+ * driver thread, the hand-off queue is not used.
+ */
+#if LWIP_TCPIP_CORE_LOCKING
+#define RX_BATCH_SIZE           0
+#else
+#define RX_BATCH_SIZE           LWIP_RX_BATCH_SIZE
+#endif
+
+#if (LWIP_MAC_TX_QUEUE_SIZE > 0) && !MAC_USE_SCATTER_GATHER
+#error "LWIP_MAC_TX_QUEUE_SIZE requires MAC_USE_SCATTER_GATHER"
+#endif
+
+#if LWIP_MAC_TX_STRESS_TEST && !MAC_USE_SCATTER_GATHER
+#error "LWIP_MAC_TX_STRESS_TEST requires MAC_USE_SCATTER_GATHER"
+#endif
+
+#if MAC_USE_TIMESTAMPS && (LWIP_MAC_TX_TIMESTAMPS < 1)
+#error "invalid LWIP_MAC_TX_TIMESTAMPS value"
+#endif
+
+#if defined(LWIP_LINK_EVENT_LINE) && !PAL_USE_CALLBACKS
+#error "LWIP_LINK_EVENT_LINE requires PAL_USE_CALLBACKS"
+#endif
+
+/*
+ * The link poll timer drives the fast polls and, without the PHY interrupt
+ * line, the polling of an established link.
+ */
+#if (LWIP_LINK_FAST_POLL_COUNT > 0) || !defined(LWIP_LINK_EVENT_LINE)
+#define LINK_USE_POLL_TIMER         TRUE
+#else
+#define LINK_USE_POLL_TIMER         FALSE
+#endif
+
+#if LWIP_OCCUPANCY_STATS && !MEMP_STATS
+#error "LWIP_OCCUPANCY_STATS requires MEMP_STATS"
+#endif
+
+#if LWIP_RX_PRIORITY && !MAC_USE_ZERO_COPY && !MEMP_STATS
+#error "LWIP_RX_PRIORITY requires MEMP_STATS in copy mode"
+#endif
+
+#if LWIP_RX_PRIORITY && (LWIP_RX_RULES < 1)
+#error "invalid LWIP_RX_RULES value"
+#endif
+
+#if LWIP_LOOPBACK_NETIF && (LWIP_NETIF_LOOPBACK || LWIP_HAVE_LOOPIF)
+#error "LWIP_LOOPBACK_NETIF requires LWIP_NETIF_LOOPBACK and LWIP_HAVE_LOOPIF disabled"
+#endif
+
+#if LWIP_LOOPBACK_NETIF && (LWIP_LOOPBACK_QUEUE_SIZE < 1)
+#error "invalid LWIP_LOOPBACK_QUEUE_SIZE value"
+#endif
+
+#if LWIP_FASTPATH_FLOWS < 0
+#error "invalid LWIP_FASTPATH_FLOWS value"
+#endif
+
+#if (LWIP_FASTPATH_FLOWS > 0) && (CH_CFG_USE_OBJ_FIFOS == FALSE)
+#error "LWIP_FASTPATH_FLOWS requires CH_CFG_USE_OBJ_FIFOS"
+#endif
+
+/*
+ * Checksums calculated by lwIP on the MAC interface, the ones handled by
+ * the MAC hardware are excluded.
+ */
+#if !defined(LWIP_NETIF_CHECKSUM_CTRL)
+#if defined(MAC_OFFLOADS_IP_CHECKSUM) && MAC_OFFLOADS_IP_CHECKSUM
+#define NETIF_CHECKSUM_IP_HW    (NETIF_CHECKSUM_GEN_IP | NETIF_CHECKSUM_CHECK_IP)
+#else
+#define NETIF_CHECKSUM_IP_HW    0
+#endif
+#if defined(MAC_OFFLOADS_TX_CHECKSUM) && MAC_OFFLOADS_TX_CHECKSUM
+#define NETIF_CHECKSUM_TX_HW    (NETIF_CHECKSUM_GEN_UDP | NETIF_CHECKSUM_GEN_TCP | \
+                                 NETIF_CHECKSUM_GEN_ICMP | NETIF_CHECKSUM_GEN_ICMP6)
+#else
+#define NETIF_CHECKSUM_TX_HW    0
+#endif
+#if defined(MAC_OFFLOADS_RX_CHECKSUM) && MAC_OFFLOADS_RX_CHECKSUM
+#define NETIF_CHECKSUM_RX_HW    (NETIF_CHECKSUM_CHECK_UDP | NETIF_CHECKSUM_CHECK_TCP | \
+                                 NETIF_CHECKSUM_CHECK_ICMP | NETIF_CHECKSUM_CHECK_ICMP6)
+#else
+#define NETIF_CHECKSUM_RX_HW    0
+#endif
+#define LWIP_NETIF_CHECKSUM_CTRL (NETIF_CHECKSUM_ENABLE_ALL &               \
+                                  ~(NETIF_CHECKSUM_IP_HW |                  \
+                                    NETIF_CHECKSUM_TX_HW |                  \
+                                    NETIF_CHECKSUM_RX_HW))
+#endif
 
 /*
  * Suspension point for initialization procedure.
@@ -93,208 +227,1737 @@ thread_reference_t lwip_trp = NULL;
 static THD_WORKING_AREA(wa_lwip_thread, LWIP_THREAD_STACK_SIZE);
 
 /*
- * Initialization.
+ * Receive statistics, updated by the driver thread.
  */
-static void low_level_init(struct netif *netif) {
-  /* set MAC hardware address length */
-  netif->hwaddr_len = ETHARP_HWADDR_LEN;
+static lwip_rx_stats_t rx_stats;
 
-  /* maximum transfer unit */
-  netif->mtu = LWIP_NETIF_MTU;
+#if LWIP_OCCUPANCY_STATS || defined(__DOXYGEN__)
+/*
+ * Occupancy of the receive pbufs and of PBUF_POOL, and periodic dump
+ * settings, accessed under the system lock.
+ */
+static struct {
+  macoccupancy_t        rx_pbufs;
+  macoccupancy_t        pbuf_pool;
+  BaseSequentialStream  *chp;
+  sysinterval_t         interval;
+  systime_t             last;
+} occupancy;
 
-  /* device capabilities */
-  /* don't set NETIF_FLAG_ETHARP if this device is not an Ethernet one */
-  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP;
+/*
+ * Samples PBUF_POOL. The pool is used by the whole stack, it is sampled by
+ * the driver thread after each receive poll and when the statistics are
+ * read.
+ */
+static void pbuf_pool_sample_i(void) {
 
-  /* Do whatever else is needed to initialize interface. */
+  macOccupancySampleX(&occupancy.pbuf_pool,
+                      (uint32_t)lwip_stats.memp[MEMP_PBUF_POOL]->used);
 }
 
 /*
- * This function does the actual transmission of the packet. The packet is
- * contained in the pbuf that is passed to the function. This pbuf
- * might be chained.
- *
- * @param netif the lwip network interface structure for this ethernetif
- * @param p the MAC packet to send (e.g. IP packet including MAC addresses and type)
- * @return ERR_OK if the packet could be sent
- *         an err_t value if the packet couldn't be sent
- *
- * @note Returning ERR_MEM here if a DMA queue of your MAC is full can lead to
- *       strange results. You might consider waiting for space in the DMA queue
- *       to become available since the stack doesn't retry to send a packet
- *       dropped because of memory failure (except for the TCP timers).
+ * Prints an occupancy record on a single line.
  */
-static err_t low_level_output(struct netif *netif, struct pbuf *p) {
+static void occupancy_print(BaseSequentialStream *chp, const char *name,
+                            const macoccupancy_t *op) {
+  unsigned i;
+
+  chprintf(chp, "%-9s %3u/%-3u hw %3u full %u %ums hist", name,
+           (unsigned)op->used, (unsigned)op->size,
+           (unsigned)op->high_water, (unsigned)op->full_events,
+           (unsigned)TIME_I2MS(op->full_time));
+  for (i = 0U; i < MAC_OCCUPANCY_BINS; i++)
+    chprintf(chp, " %u", (unsigned)op->histogram[i]);
+  chprintf(chp, "\n");
+}
+
+/*
+ * Prints the occupancy statistics if the dump interval elapsed, called
+ * by the driver thread on the periodic timer.
+ */
+static void occupancy_dump(void) {
+  /* Static in order to keep the thread stack small.*/
+  static lwip_occupancy_stats_t os;
+  BaseSequentialStream *chp;
+
+  osalSysLock();
+  chp = occupancy.chp;
+  if ((chp == NULL) ||
+      (osalTimeDiffX(occupancy.last, osalOsGetSystemTimeX()) <
+       occupancy.interval)) {
+    osalSysUnlock();
+    return;
+  }
+  occupancy.last = osalOsGetSystemTimeX();
+  osalSysUnlock();
+
+  lwipGetOccupancyStats(&os);
+  {
+    uint64_t now = mclkGetMicrosecondsX();
+
+    chprintf(chp, "occupancy at %u.%06us\n",
+             MCLK_US2S(now), MCLK_US2SFRAC(now));
+  }
+#if MAC_USE_RING_STATISTICS
+  occupancy_print(chp, "rx ring", &os.rings.rx);
+  occupancy_print(chp, "tx ring", &os.rings.tx);
+#endif
+#if MAC_USE_ZERO_COPY
+  occupancy_print(chp, "rx pbufs", &os.rx_pbufs);
+#endif
+  occupancy_print(chp, "pbuf pool", &os.pbuf_pool);
+}
+#endif
+
+#if MAC_USE_ZERO_COPY || defined(__DOXYGEN__)
+/*
+ * Custom pbuf wrapping a MAC receive buffer, frames spread over multiple
+ * buffers are chains of custom pbufs sharing the descriptor of the first
+ * one.
+ */
+typedef struct rx_pbuf {
+  struct pbuf_custom    pc;
+  MACReceiveDescriptor  rd;
+  struct rx_pbuf        *first;
+  unsigned              segments;
+} rx_pbuf_t;
+
+static rx_pbuf_t rx_pbufs[LWIP_MAC_RX_PBUFS];
+static MEMORYPOOL_DECL(rx_pbuf_pool, sizeof (rx_pbuf_t), PORT_NATURAL_ALIGN,
+                       NULL);
+
+/*
+ * Custom pbufs in use, accessed under the system lock.
+ */
+static unsigned rx_pbufs_used;
+
+/*
+ * Returns the receive buffer to the MAC when the stack frees the pbuf, it
+ * can be called from any thread.
+ */
+static void rx_pbuf_free(struct pbuf *p) {
+  rx_pbuf_t *rxp = (rx_pbuf_t *)p;
+  rx_pbuf_t *first = rxp->first;
+
+  osalSysLock();
+  if (rxp != first) {
+    chPoolFreeI(&rx_pbuf_pool, rxp);
+    rx_pbufs_used--;
+  }
+  if (--first->segments == 0U) {
+    macReleaseReceiveDescriptorX(&first->rd);
+    chPoolFreeI(&rx_pbuf_pool, first);
+    rx_pbufs_used--;
+  }
+#if LWIP_OCCUPANCY_STATS
+  macOccupancySampleX(&occupancy.rx_pbufs, rx_pbufs_used);
+#endif
+  osalSysUnlock();
+}
+
+/*
+ * Returns the number of MAC buffers spanned by a received frame, the
+ * descriptor is scanned on a copy.
+ */
+static size_t rx_pbuf_segments(const MACReceiveDescriptor *rdp) {
+  MACReceiveDescriptor rd = *rdp;
+  size_t n = 0U, size;
+
+  while (macGetNextReceiveBuffer(&rd, &size) != NULL)
+    n++;
+
+  return n;
+}
+
+/*
+ * Checks if a frame can be wrapped leaving LWIP_MAC_RX_PBUFS_LOW_WATER
+ * custom pbufs free, the frames held by the stack must not starve the
+ * reception of the frames that would release them.
+ */
+static bool rx_pbuf_can_wrap(const MACReceiveDescriptor *rdp) {
+  size_t avail;
+
+  osalSysLock();
+  avail = LWIP_MAC_RX_PBUFS - rx_pbufs_used;
+  osalSysUnlock();
+
+  return avail >= rx_pbuf_segments(rdp) + LWIP_MAC_RX_PBUFS_LOW_WATER;
+}
+
+/*
+ * Wraps the MAC receive buffers of a frame in a chain of custom pbufs.
+ * Returns NULL if the pool is exhausted, the descriptor is then still owned
+ * by the caller.
+ */
+static struct pbuf *rx_pbuf_wrap(const MACReceiveDescriptor *rdp) {
+  rx_pbuf_t *first, *rxp;
+  struct pbuf *p = NULL, *q;
+  const uint8_t *buf;
+  size_t size;
+
+  first = chPoolAlloc(&rx_pbuf_pool);
+  if (first == NULL)
+    return NULL;
+  first->rd       = *rdp;
+  first->segments = 0U;
+
+  rxp = first;
+  while ((buf = macGetNextReceiveBuffer(&first->rd, &size)) != NULL) {
+    if (rxp == NULL)
+      rxp = chPoolAlloc(&rx_pbuf_pool);
+    if (rxp == NULL) {
+      /* Not yet seen by the stack, segments are returned directly, the
+         first one included.*/
+      while (p != NULL) {
+        q = p->next;
+        chPoolFree(&rx_pbuf_pool, p);
+        p = q;
+      }
+      return NULL;
+    }
+    rxp->first = first;
+    rxp->pc.custom_free_function = rx_pbuf_free;
+    q = pbuf_alloced_custom(PBUF_RAW, (u16_t)size, PBUF_REF, &rxp->pc,
+                            (void *)buf, (u16_t)size);
+    if (p == NULL)
+      p = q;
+    else
+      pbuf_cat(p, q);
+    first->segments++;
+    rxp = NULL;
+  }
+
+  /* Not yet seen by the stack, no frees can happen before this point.*/
+  osalSysLock();
+  rx_pbufs_used += first->segments;
+#if LWIP_OCCUPANCY_STATS
+  macOccupancySampleX(&occupancy.rx_pbufs, rx_pbufs_used);
+#endif
+  osalSysUnlock();
+
+  return p;
+}
+#endif
+
+#if (MAC_USE_TIMESTAMPS && MAC_USE_SCATTER_GATHER) || defined(__DOXYGEN__)
+/*
+ * Transmission timestamp of a pbuf, only frames transmitted in place are
+ * timestamped.
+ */
+typedef struct {
+  const struct pbuf     *p;
+  mactimestamp_t        ts;
+} tx_timestamp_t;
+
+static tx_timestamp_t tx_timestamps[LWIP_MAC_TX_TIMESTAMPS];
+static unsigned tx_timestamps_wr;
+
+/*
+ * Forgets the timestamps recorded for the pbufs of a chain, the pbufs are
+ * about to be transmitted again or have been reused.
+ */
+static void tx_timestamp_invalidate(const struct pbuf *p) {
+  unsigned i;
+
+  osalSysLock();
+  for (; p != NULL; p = p->next) {
+    for (i = 0U; i < LWIP_MAC_TX_TIMESTAMPS; i++) {
+      if (tx_timestamps[i].p == p)
+        tx_timestamps[i].p = NULL;
+    }
+  }
+  osalSysUnlock();
+}
+
+/*
+ * Records the timestamp of a transmitted frame for all the pbufs of its
+ * chain, the oldest entries are overwritten.
+ */
+static void tx_timestamp_record(const struct pbuf *p,
+                                const mactimestamp_t *tsp) {
+
+  if (tsp->nsec == MAC_TIMESTAMP_INVALID)
+    return;
+
+  osalSysLock();
+  for (; p != NULL; p = p->next) {
+    tx_timestamps[tx_timestamps_wr].p  = p;
+    tx_timestamps[tx_timestamps_wr].ts = *tsp;
+    tx_timestamps_wr = (tx_timestamps_wr + 1U) % LWIP_MAC_TX_TIMESTAMPS;
+  }
+  osalSysUnlock();
+}
+#endif
+
+#if MAC_USE_SCATTER_GATHER || defined(__DOXYGEN__)
+/*
+ * Pbufs transmitted in place. Those referencing external data, which can be
+ * volatile or out of the DMA reach, are copied.
+ */
+#define TX_PBUF_IN_PLACE(q)                                                 \
+  (!pbuf_match_allocsrc(q, PBUF_TYPE_ALLOC_SRC_MASK_STD_MEMP_PBUF))
+
+/*
+ * Frees the pbuf chains of the frames already transmitted by the MAC.
+ */
+static void low_level_tx_reclaim(void) {
+  mactimestamp_t ts;
+  struct pbuf *p;
+
+  while ((p = macReclaimTransmitBuffers(&ETHD1, &ts)) != NULL) {
+#if MAC_USE_TIMESTAMPS
+    tx_timestamp_record(p, &ts);
+#else
+    (void)ts;
+#endif
+    pbuf_free(p);
+  }
+}
+#endif
+
+#if (MAC_USE_SCATTER_GATHER && (LWIP_MAC_TX_QUEUE_SIZE == 0)) || defined(__DOXYGEN__)
+/*
+ * Transmits a frame directly from the pbuf chain, the chain is referenced
+ * until the MAC reports it as transmitted.
+ * Returns MSG_RESET if the frame has to be copied instead.
+ */
+static msg_t low_level_output_sg(struct pbuf *p) {
+  macbuffer_t bufs[MAC_MAX_FRAME_BUFFERS];
   struct pbuf *q;
-  MACTransmitDescriptor td;
+  size_t n = 0U;
+  msg_t msg;
+
+  low_level_tx_reclaim();
+
+  /* Chains with external data or too many segments are copied.*/
+  for (q = p; q != NULL; q = q->next) {
+    if (q->len == 0U)
+      continue;
+    if ((n >= MAC_MAX_FRAME_BUFFERS) || !TX_PBUF_IN_PLACE(q))
+      return MSG_RESET;
+    bufs[n].buf  = (const uint8_t *)q->payload;
+    bufs[n].size = (size_t)q->len;
+    n++;
+  }
 
-  (void)netif;
-  if (macWaitTransmitDescriptor(&ETHD1, &td, TIME_MS2I(LWIP_SEND_TIMEOUT)) != MSG_OK)
-    return ERR_TIMEOUT;
+  pbuf_ref(p);
+  msg = macTransmitBuffers(&ETHD1, bufs, n, p, TIME_MS2I(LWIP_SEND_TIMEOUT));
+  if (msg != MSG_OK)
+    pbuf_free(p);
 
-#if ETH_PAD_SIZE
-  pbuf_header(p, -ETH_PAD_SIZE);        /* drop the padding word */
+  return msg;
+}
 #endif
 
-  /* Iterates through the pbuf chain. */
-  for(q = p; q != NULL; q = q->next)
-    macWriteTransmitDescriptor(&td, (uint8_t *)q->payload, (size_t)q->len);
-  macReleaseTransmitDescriptorX(&td);
+#if (LWIP_MAC_TX_QUEUE_SIZE > 0) || defined(__DOXYGEN__)
+/*
+ * Frame waiting in the software transmit queue.
+ */
+typedef struct {
+  struct pbuf           *p;
+  size_t                n;
+  macbuffer_t           bufs[MAC_MAX_FRAME_BUFFERS];
+} tx_frame_t;
 
-  MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
-  if (((u8_t*)p->payload)[0] & 1) {
-    /* broadcast or multicast packet*/
-    MIB2_STATS_NETIF_INC(netif, ifoutnucastpkts);
-  } 
+static tx_frame_t tx_queue[LWIP_MAC_TX_QUEUE_SIZE];
+static unsigned tx_queue_rd, tx_queue_cnt;
+static lwip_txq_stats_t tx_queue_stats;
+
+/*
+ * Moves the queued frames to the MAC until it runs out of descriptors,
+ * returns the number of frames moved.
+ */
+static unsigned tx_queue_drain_i(void) {
+  unsigned n = 0U;
+
+  while (tx_queue_cnt > 0U) {
+    tx_frame_t *fp = &tx_queue[tx_queue_rd];
+    msg_t msg;
+
+    msg = macTransmitBuffersI(&ETHD1, fp->bufs, fp->n, fp->p);
+    if (msg == MSG_TIMEOUT)
+      break;
+    osalDbgAssert(msg == MSG_OK, "frame not in DMA memory");
+
+    tx_queue_rd = (tx_queue_rd + 1U) % LWIP_MAC_TX_QUEUE_SIZE;
+    tx_queue_cnt--;
+    n++;
+  }
+  tx_queue_stats.depth = tx_queue_cnt;
+
+  return n;
+}
+
+/*
+ * MAC callback, it refills the transmit descriptors from the queue on
+ * TX-complete interrupts.
+ */
+static void tx_queue_cb(MACDriver *macp) {
+
+  (void)macp;
+
+  osalSysLockFromISR();
+  tx_queue_stats.drained_isr += tx_queue_drain_i();
+  osalSysUnlockFromISR();
+}
+
+/*
+ * Maps a frame on a queue entry, only chains made of lwIP heap or pool
+ * pbufs are transmitted in place.
+ */
+static bool tx_frame_map(tx_frame_t *fp, struct pbuf *p) {
+  struct pbuf *q;
+
+  fp->p = p;
+  fp->n = 0U;
+  for (q = p; q != NULL; q = q->next) {
+    if (q->len == 0U)
+      continue;
+    if ((fp->n >= MAC_MAX_FRAME_BUFFERS) || !TX_PBUF_IN_PLACE(q))
+      return false;
+    fp->bufs[fp->n].buf  = (const uint8_t *)q->payload;
+    fp->bufs[fp->n].size = (size_t)q->len;
+    fp->n++;
+  }
+
+  return true;
+}
+
+/*
+ * Enqueues a frame without waiting, ERR_WOULDBLOCK is returned if both the
+ * MAC descriptors and the software queue are full.
+ */
+static err_t low_level_output_queued(struct pbuf *p) {
+  tx_frame_t frame;
+
+  low_level_tx_reclaim();
+
+  /* Chains referencing external or volatile data are copied in a single
+     pbuf from the lwIP heap.*/
+  if (tx_frame_map(&frame, p)) {
+    pbuf_ref(p);
+  }
   else {
-    /* unicast packet */
-    MIB2_STATS_NETIF_INC(netif, ifoutucastpkts);
+    p = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+    if (p == NULL)
+      return ERR_MEM;
+    (void)tx_frame_map(&frame, p);
   }
-  /* increase ifoutdiscards or ifouterrors on error */
 
-#if ETH_PAD_SIZE
-  pbuf_header(p, ETH_PAD_SIZE);         /* reclaim the padding word */
-#endif
+  osalSysLock();
 
-  LINK_STATS_INC(link.xmit);
+  /* Frames already in the queue go first.*/
+  (void)tx_queue_drain_i();
+  if ((tx_queue_cnt == 0U) &&
+      (macTransmitBuffersI(&ETHD1, frame.bufs, frame.n, p) == MSG_OK)) {
+    osalSysUnlock();
+    return ERR_OK;
+  }
+
+  if (tx_queue_cnt >= LWIP_MAC_TX_QUEUE_SIZE) {
+    tx_queue_stats.rejected++;
+    osalSysUnlock();
+    pbuf_free(p);
+    return ERR_WOULDBLOCK;
+  }
+
+  tx_queue[(tx_queue_rd + tx_queue_cnt) % LWIP_MAC_TX_QUEUE_SIZE] = frame;
+  tx_queue_cnt++;
+  tx_queue_stats.queued++;
+  tx_queue_stats.depth = tx_queue_cnt;
+  if (tx_queue_cnt > tx_queue_stats.max_depth)
+    tx_queue_stats.max_depth = tx_queue_cnt;
+
+  osalSysUnlock();
 
   return ERR_OK;
 }
+#endif
 
+#if LWIP_MAC_TX_STRESS_TEST || defined(__DOXYGEN__)
 /*
- * Receives a frame.
- * Allocates a pbuf and transfers the bytes of the incoming
- * packet from the interface into the pbuf.
- *
- * @param netif the lwip network interface structure for this ethernetif
- * @return a pbuf filled with the received packet (including MAC header)
- *         NULL on memory error
+ * Transmit stress test state, each frame is identified by a cookie pointing
+ * to its reclaim counter.
  */
-static bool low_level_input(struct netif *netif, struct pbuf **pbuf) {
-  MACReceiveDescriptor rd;
-  struct pbuf *q;
-  u16_t len;
+#define TX_STRESS_FRAMES        1024U
+#define TX_STRESS_RECLAIM       2U
 
-  (void)netif;
+static struct {
+  uint8_t               frame[60];
+  macbuffer_t           buf;
+  unsigned              next;
+  uint8_t               reclaimed[TX_STRESS_FRAMES];
+} tx_stress;
 
-  osalDbgAssert(pbuf != NULL, "invalid null pointer");
+/*
+ * Enqueues frames until the MAC refuses them.
+ */
+static void tx_stress_refill_i(void) {
+
+  while ((tx_stress.next < TX_STRESS_FRAMES) &&
+         (macTransmitBuffersI(&ETHD1, &tx_stress.buf, 1U,
+                              &tx_stress.reclaimed[tx_stress.next]) == MSG_OK)) {
+    tx_stress.next++;
+  }
+}
+
+/*
+ * MAC callback, it refills the ring on each TX-complete interrupt.
+ */
+static void tx_stress_cb(MACDriver *macp) {
+
+  (void)macp;
+
+  osalSysLockFromISR();
+  tx_stress_refill_i();
+  osalSysUnlockFromISR();
+}
+
+/**
+ * @brief   Transmit descriptors stress test.
+ * @details The transmit ring is refilled from the TX-complete interrupt
+ *          while the cookies are reclaimed, a few per millisecond, at a
+ *          much lower rate. Each cookie must be reclaimed exactly once.
+ *          Broadcast frames with the local experimental Ethertype are
+ *          transmitted, the link must be up within five seconds.
+ * @note    The test uses the MAC driver, it must be run before
+ *          @p lwipInit().
+ *
+ * @param[in] chp       stream receiving the report
+ * @return              The test outcome.
+ * @retval true         if all the cookies were reclaimed exactly once.
+ *
+ * @api
+ */
+bool lwipMacTxStressTest(BaseSequentialStream *chp) {
+  static uint8_t hwaddr[6] = {LWIP_ETHADDR_0, LWIP_ETHADDR_1,
+                              LWIP_ETHADDR_2, LWIP_ETHADDR_3,
+                              LWIP_ETHADDR_4, LWIP_ETHADDR_5};
+  static const MACConfig config = {hwaddr};
+  unsigned i, reclaimed = 0U, lost = 0U, dups = 0U, strays = 0U;
+  systime_t start;
+  void *cookie;
+
+  memset(&tx_stress, 0, sizeof (tx_stress));
+  memset(&tx_stress.frame[0], 0xFF, 6);
+  memcpy(&tx_stress.frame[6], hwaddr, 6);
+  tx_stress.frame[12] = 0x88;
+  tx_stress.frame[13] = 0xB5;
+  tx_stress.buf.buf  = tx_stress.frame;
+  tx_stress.buf.size = sizeof (tx_stress.frame);
+
+  macSetCallbackX(&ETHD1, tx_stress_cb);
+  macStart(&ETHD1, &config);
+
+  start = chVTGetSystemTimeX();
+  while (!macPollLinkStatus(&ETHD1)) {
+    if (chVTTimeElapsedSinceX(start) > TIME_S2I(5)) {
+      chprintf(chp, "TX stress: link down, skipped\r\n");
+      macStop(&ETHD1);
+      macSetCallbackX(&ETHD1, NULL);
+      return false;
+    }
+    chThdSleepMilliseconds(100);
+  }
+
+  osalSysLock();
+  tx_stress_refill_i();
+  osalSysUnlock();
+
+  /* The reclaim is deliberately slower than the transmission, the refill
+     from the interrupt hits the limit of the unreclaimed cookies.*/
+  start = chVTGetSystemTimeX();
+  while ((reclaimed + strays < TX_STRESS_FRAMES) &&
+         (chVTTimeElapsedSinceX(start) < TIME_S2I(10))) {
+    chThdSleepMilliseconds(1);
+    for (i = 0U; i < TX_STRESS_RECLAIM; i++) {
+      cookie = macReclaimTransmitBuffers(&ETHD1, NULL);
+      if (cookie == NULL)
+        break;
+      if (((uint8_t *)cookie < &tx_stress.reclaimed[0]) ||
+          ((uint8_t *)cookie >= &tx_stress.reclaimed[TX_STRESS_FRAMES])) {
+        strays++;
+        continue;
+      }
+      (*(uint8_t *)cookie)++;
+      reclaimed++;
+    }
+
+    /* The refill is resumed here if it stopped at the cookies limit.*/
+    osalSysLock();
+    tx_stress_refill_i();
+    osalSysUnlock();
+  }
+
+  macStop(&ETHD1);
+  macSetCallbackX(&ETHD1, NULL);
+
+  for (i = 0U; i < TX_STRESS_FRAMES; i++) {
+    if (tx_stress.reclaimed[i] == 0U)
+      lost++;
+    else if (tx_stress.reclaimed[i] > 1U)
+      dups++;
+  }
+  chprintf(chp, "TX stress: %u frames, %u enqueued, %u lost, %u reclaimed "
+                "twice, %u unknown: %s\r\n",
+           TX_STRESS_FRAMES, tx_stress.next, lost, dups, strays,
+           ((lost | dups | strays) == 0U) ? "PASS" : "FAIL");
+
+  return (lost | dups | strays) == 0U;
+}
+#endif
+
+#if (MAC_USE_FILTERS && LWIP_IPV4 && LWIP_IGMP) || defined(__DOXYGEN__)
+/*
+ * Programs the MAC filters with the IPv4 multicast groups joined by lwIP.
+ */
+static err_t igmp_mac_filter(struct netif *netif, const ip4_addr_t *group,
+                             enum netif_mac_filter_action action) {
+  uint8_t addr[6];
+
+  (void)netif;
+
+  addr[0] = 0x01;
+  addr[1] = 0x00;
+  addr[2] = 0x5E;
+  addr[3] = ip4_addr2(group) & 0x7F;
+  addr[4] = ip4_addr3(group);
+  addr[5] = ip4_addr4(group);
+
+  if (action == NETIF_ADD_MAC_FILTER) {
+    macAddMulticastAddress(&ETHD1, addr);
+    return ERR_OK;
+  }
+  return macRemoveMulticastAddress(&ETHD1, addr) == MSG_OK ? ERR_OK : ERR_ARG;
+}
+#endif
+
+#if (MAC_USE_FILTERS && LWIP_IPV6 && LWIP_IPV6_MLD) || defined(__DOXYGEN__)
+/*
+ * Programs the MAC filters with the IPv6 multicast groups joined by lwIP.
+ */
+static err_t mld_mac_filter(struct netif *netif, const ip6_addr_t *group,
+                            enum netif_mac_filter_action action) {
+  const u8_t *p = (const u8_t *)&group->addr[3];
+  uint8_t addr[6];
+
+  (void)netif;
+
+  addr[0] = 0x33;
+  addr[1] = 0x33;
+  addr[2] = p[0];
+  addr[3] = p[1];
+  addr[4] = p[2];
+  addr[5] = p[3];
+
+  if (action == NETIF_ADD_MAC_FILTER) {
+    macAddMulticastAddress(&ETHD1, addr);
+    return ERR_OK;
+  }
+  return macRemoveMulticastAddress(&ETHD1, addr) == MSG_OK ? ERR_OK : ERR_ARG;
+}
+#endif
+
+/*
+ * Initialization.
+ */
+static void low_level_init(struct netif *netif) {
+  /* set MAC hardware address length */
+  netif->hwaddr_len = ETHARP_HWADDR_LEN;
+
+  /* maximum transfer unit */
+  netif->mtu = LWIP_NETIF_MTU;
+
+  /* device capabilities */
+  /* don't set NETIF_FLAG_ETHARP if this device is not an Ethernet one */
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP;
+#if MAC_USE_FILTERS && LWIP_IPV4 && LWIP_IGMP
+  netif->flags |= NETIF_FLAG_IGMP;
+#endif
+#if MAC_USE_FILTERS && LWIP_IPV6 && LWIP_IPV6_MLD
+  netif->flags |= NETIF_FLAG_MLD6;
+#endif
+
+  /* Do whatever else is needed to initialize interface. */
+}
+
+#if (LWIP_MAC_TX_QUEUE_SIZE == 0) || defined(__DOXYGEN__)
+/*
+ * Copies the frame into a MAC transmit buffer and transmits it.
+ */
+static err_t low_level_output_copy(struct pbuf *p) {
+#if !MAC_USE_ZERO_COPY
+  struct pbuf *q;
+#endif
+  MACTransmitDescriptor td;
+
+  if (macWaitTransmitDescriptor(&ETHD1, &td, TIME_MS2I(LWIP_SEND_TIMEOUT)) != MSG_OK)
+    return ERR_TIMEOUT;
+
+#if MAC_USE_ZERO_COPY
+  {
+    uint8_t *buf;
+    size_t size;
+
+    /* The whole frame fits a single transmit buffer.*/
+    buf = macGetNextTransmitBuffer(&td, (size_t)p->tot_len, &size);
+    pbuf_copy_partial(p, buf, (u16_t)LWIP_MIN(size, (size_t)p->tot_len), 0);
+  }
+#else
+  /* Iterates through the pbuf chain. */
+  for(q = p; q != NULL; q = q->next)
+    macWriteTransmitDescriptor(&td, (uint8_t *)q->payload, (size_t)q->len);
+#endif
+  macReleaseTransmitDescriptorX(&td);
+
+  return ERR_OK;
+}
+#endif
+
+/*
+ * This function does the actual transmission of the packet. The packet is
+ * contained in the pbuf that is passed to the function. This pbuf
+ * might be chained.
+ *
+ * @param netif the lwip network interface structure for this ethernetif
+ * @param p the MAC packet to send (e.g. IP packet including MAC addresses and type)
+ * @return ERR_OK if the packet could be sent
+ *         an err_t value if the packet couldn't be sent
+ *
+ * @note Returning ERR_MEM here if a DMA queue of your MAC is full can lead to
+ *       strange results. You might consider waiting for space in the DMA queue
+ *       to become available since the stack doesn't retry to send a packet
+ *       dropped because of memory failure (except for the TCP timers).
+ */
+static err_t low_level_output(struct netif *netif, struct pbuf *p) {
+  err_t err;
+
+  (void)netif;
+
+#if ETH_PAD_SIZE
+  pbuf_header(p, -ETH_PAD_SIZE);        /* drop the padding word */
+#endif
+
+#if MAC_USE_TIMESTAMPS && MAC_USE_SCATTER_GATHER
+  tx_timestamp_invalidate(p);
+#endif
+
+#if LWIP_MAC_TX_QUEUE_SIZE > 0
+  err = low_level_output_queued(p);
+#elif MAC_USE_SCATTER_GATHER
+  switch (low_level_output_sg(p)) {
+  case MSG_OK:
+    err = ERR_OK;
+    break;
+  case MSG_TIMEOUT:
+    err = ERR_TIMEOUT;
+    break;
+  default:
+    /* The frame cannot be sent in place, falling back to copy.*/
+    err = low_level_output_copy(p);
+    break;
+  }
+#else
+  err = low_level_output_copy(p);
+#endif
+
+#if ETH_PAD_SIZE
+  pbuf_header(p, ETH_PAD_SIZE);         /* reclaim the padding word */
+#endif
+
+  if (err != ERR_OK)
+    return err;
+
+  MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
+  if (((u8_t*)p->payload)[0] & 1) {
+    /* broadcast or multicast packet*/
+    MIB2_STATS_NETIF_INC(netif, ifoutnucastpkts);
+  } 
+  else {
+    /* unicast packet */
+    MIB2_STATS_NETIF_INC(netif, ifoutucastpkts);
+  }
+  /* increase ifoutdiscards or ifouterrors on error */
+
+  LINK_STATS_INC(link.xmit);
+
+  return ERR_OK;
+}
+
+#if LWIP_RX_PRIORITY || defined(__DOXYGEN__)
+/*
+ * Frame bytes peeked for the classification, up to the ports of an IPv4
+ * datagram with a VLAN tag and no IP options.
+ */
+#define RX_PEEK_SIZE            42U
+
+/*
+ * Port rules, accessed under the system lock.
+ */
+static lwip_rx_rule_t rx_rules[LWIP_RX_RULES];
+static unsigned rx_rules_n;
+
+/*
+ * Returns the class of a frame from its first bytes. The port rules take
+ * precedence, then high VLAN priorities and DSCPs, broadcast and multicast
+ * frames other than ARP are in the low class.
+ */
+static lwip_rx_class_t rx_classify(const uint8_t *f, size_t n) {
+  lwip_rx_class_t cls;
+  size_t off = 14U;
+  u16_t type;
+
+  if (n < off)
+    return LWIP_RX_CLASS_LOW;
+
+  cls  = (f[0] & 1U) != 0U ? LWIP_RX_CLASS_LOW : LWIP_RX_CLASS_NORMAL;
+  type = (u16_t)((f[12] << 8) | f[13]);
+  if ((type == ETHTYPE_VLAN) && (n >= off + 4U)) {
+    if ((f[14] >> 5) >= LWIP_RX_HIGH_PCP)
+      cls = LWIP_RX_CLASS_HIGH;
+    type = (u16_t)((f[16] << 8) | f[17]);
+    off += 4U;
+  }
+
+  if (type == ETHTYPE_ARP) {
+    /* Requests are broadcast, they are needed by all the traffic.*/
+    if (cls == LWIP_RX_CLASS_LOW)
+      cls = LWIP_RX_CLASS_NORMAL;
+  }
+  else if ((type == ETHTYPE_IP) && (n >= off + IP_HLEN) &&
+           ((f[off] >> 4) == 4U)) {
+    const uint8_t *ip = f + off;
+    size_t ihl = (size_t)(ip[0] & 0x0FU) * 4U;
+
+    if ((ip[1] >> 2) >= LWIP_RX_HIGH_DSCP)
+      cls = LWIP_RX_CLASS_HIGH;
+
+    /* Destination port of the first or only fragment.*/
+    if (((ip[9] == IP_PROTO_UDP) || (ip[9] == IP_PROTO_TCP)) &&
+        ((ip[6] & 0x1FU) == 0U) && (ip[7] == 0U) && (n >= off + ihl + 4U)) {
+      u16_t port = (u16_t)((ip[ihl + 2U] << 8) | ip[ihl + 3U]);
+      unsigned i;
+
+      osalSysLock();
+      for (i = 0U; i < rx_rules_n; i++) {
+        if ((rx_rules[i].port == port) &&
+            ((rx_rules[i].proto == 0U) || (rx_rules[i].proto == ip[9]))) {
+          cls = rx_rules[i].cls;
+          break;
+        }
+      }
+      osalSysUnlock();
+    }
+  }
+
+  return cls;
+}
+
+/*
+ * Classifies a received frame, before any buffer is taken for it, and
+ * checks that the free receive buffers exceed the reserve of the higher
+ * classes. The headers are peeked through a copy of the descriptor,
+ * nothing is consumed.
+ */
+static bool rx_admit(const MACReceiveDescriptor *rdp,
+                     lwip_rx_class_t *clsp) {
+  MACReceiveDescriptor peek = *rdp;
+  uint8_t hdr[RX_PEEK_SIZE];
+  size_t n, avail, needed, reserve;
+  lwip_rx_class_t cls;
+
+  n = macReadReceiveDescriptor(&peek, hdr, sizeof (hdr));
+  cls = rx_classify(hdr, n);
+  *clsp = cls;
+  rx_stats.class_frames[cls]++;
+
+  if (cls == LWIP_RX_CLASS_HIGH)
+    reserve = 0U;
+  else if (cls == LWIP_RX_CLASS_NORMAL)
+    reserve = LWIP_RX_RESERVE_HIGH;
+  else
+    reserve = LWIP_RX_RESERVE_HIGH + LWIP_RX_RESERVE_NORMAL;
+
+#if MAC_USE_ZERO_COPY
+  /* One custom pbuf for each MAC buffer spanned by the frame.*/
+  osalSysLock();
+  avail = LWIP_MAC_RX_PBUFS - rx_pbufs_used;
+  osalSysUnlock();
+  needed = rx_pbuf_segments(rdp);
+#else
+  /* Read without locking, it is only a hint.*/
+  avail  = (size_t)(lwip_stats.memp[MEMP_PBUF_POOL]->avail -
+                    lwip_stats.memp[MEMP_PBUF_POOL]->used);
+  needed = (rdp->size + ETH_PAD_SIZE + PBUF_POOL_BUFSIZE - 1U) /
+           PBUF_POOL_BUFSIZE;
+#endif
+
+  if (avail >= needed + reserve)
+    return true;
+
+  rx_stats.class_drops[cls]++;
+  return false;
+}
+#endif
+
+/*
+ * Receives a frame.
+ * Allocates a pbuf and transfers the bytes of the incoming
+ * packet from the interface into the pbuf.
+ *
+ * @param netif the lwip network interface structure for this ethernetif
+ * @return a pbuf filled with the received packet (including MAC header)
+ *         NULL on memory error
+ */
+static bool low_level_input(struct netif *netif, struct pbuf **pbuf) {
+  MACReceiveDescriptor rd;
+#if LWIP_RX_PRIORITY
+  lwip_rx_class_t cls;
+#endif
+  struct pbuf *q;
+  bool copied = true;
+  u16_t len;
+
+  (void)netif;
+
+  osalDbgAssert(pbuf != NULL, "invalid null pointer");
+
+  if (macWaitReceiveDescriptor(&ETHD1, &rd, TIME_IMMEDIATE) != MSG_OK)
+    return false;
+
+#if LWIP_RX_PRIORITY
+  if (!rx_admit(&rd, &cls)) {
+    /* Receive buffers held back for the higher classes.*/
+    macReleaseReceiveDescriptorX(&rd);
+    LINK_STATS_INC(link.drop);
+    MIB2_STATS_NETIF_INC(netif, ifindiscards);
+    *pbuf = NULL;
+    return true;
+  }
+#endif
+
+  len = (u16_t)rd.size;
+
+#if ETH_PAD_SIZE
+  len += ETH_PAD_SIZE;        /* allow room for Ethernet padding */
+#endif
+
+#if MAC_USE_ZERO_COPY
+  /* The MAC buffers are wrapped in custom pbufs, the descriptor is owned by
+     the pbufs until they are freed. Near the exhaustion of the custom pbufs
+     the frame is copied in PBUF_POOL instead and the MAC buffers are
+     returned immediately.*/
+  *pbuf = NULL;
+  if (rx_pbuf_can_wrap(&rd))
+    *pbuf = rx_pbuf_wrap(&rd);
+  if (*pbuf != NULL) {
+    copied = false;
+  }
+  else {
+    rx_stats.copied++;
+    *pbuf = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+  }
+#else
+  /* We allocate a pbuf chain of pbufs from the pool. */
+  *pbuf = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+#endif
+
+  if (*pbuf != NULL) {
+#if MAC_USE_TIMESTAMPS
+    /* Reception timestamp carried by the first pbuf of the chain up to
+       the application, LWIP_PBUF_CUSTOM_DATA must declare the ts_sec and
+       ts_nsec fields.*/
+    (*pbuf)->ts_sec  = rd.ts.sec;
+    (*pbuf)->ts_nsec = rd.ts.nsec;
+#endif
+#if ETH_PAD_SIZE
+    pbuf_header(*pbuf, -ETH_PAD_SIZE); /* drop the padding word */
+#endif
+
+    if (copied) {
+      /* Iterates through the pbuf chain. */
+      for(q = *pbuf; q != NULL; q = q->next)
+        macReadReceiveDescriptor(&rd, (uint8_t *)q->payload, (size_t)q->len);
+      macReleaseReceiveDescriptorX(&rd);
+    }
+
+    MIB2_STATS_NETIF_ADD(netif, ifinoctets, (*pbuf)->tot_len);
+
+    if (*(uint8_t *)((*pbuf)->payload) & 1) {
+      /* broadcast or multicast packet*/
+      MIB2_STATS_NETIF_INC(netif, ifinnucastpkts);
+    } 
+    else {
+      /* unicast packet*/
+      MIB2_STATS_NETIF_INC(netif, ifinucastpkts);
+    }
+
+#if ETH_PAD_SIZE
+    pbuf_header(*pbuf, ETH_PAD_SIZE); /* reclaim the padding word */
+#endif
+
+    LINK_STATS_INC(link.recv);
+  }
+  else {
+    macReleaseReceiveDescriptorX(&rd);     // Drop packet
+    rx_stats.exhausted++;
+#if LWIP_RX_PRIORITY
+    rx_stats.class_drops[cls]++;
+#endif
+    LINK_STATS_INC(link.memerr);
+    LINK_STATS_INC(link.drop);
+    MIB2_STATS_NETIF_INC(netif, ifindiscards);
+  }
+  
+  return true;
+}
+
+/*
+ * Called at the beginning of the program to set up the
+ * network interface. It calls the function low_level_init() to do the
+ * actual setup of the hardware.
+ *
+ * This function should be passed as a parameter to netifapi_netif_add().
+ *
+ * @param netif the lwip network interface structure for this ethernetif
+ * @return ERR_OK if the loopif is initialised
+ *         ERR_MEM if private data couldn't be allocated
+ *         any other err_t on error
+ */
+static err_t ethernetif_init(struct netif *netif) {
+  osalDbgAssert((netif != NULL), "netif != NULL");
+
+  /*
+   * Initialize the snmp variables and counters inside the struct netif.
+   * The last argument should be replaced with your link speed, in units
+   * of bits per second.
+   */
+  MIB2_INIT_NETIF(netif, snmp_ifType_ethernet_csmacd, LWIP_LINK_SPEED);
+
+  netif->state = NULL;
+  netif->name[0] = LWIP_IFNAME0;
+  netif->name[1] = LWIP_IFNAME1;
+#if LWIP_CHECKSUM_CTRL_PER_NETIF
+  NETIF_SET_CHECKSUM_CTRL(netif, LWIP_NETIF_CHECKSUM_CTRL);
+#endif
+#if MAC_USE_FILTERS && LWIP_IPV4 && LWIP_IGMP
+  netif_set_igmp_mac_filter(netif, igmp_mac_filter);
+#endif
+#if MAC_USE_FILTERS && LWIP_IPV6 && LWIP_IPV6_MLD
+  netif_set_mld_mac_filter(netif, mld_mac_filter);
+#endif
+  /* We directly use etharp_output() here to save a function call.
+   * You can instead declare your own function an call etharp_output()
+   * from it if you have to do some checks before sending (e.g. if link
+   * is available...) */
+  netif->output = etharp_output;
+  netif->linkoutput = low_level_output;
+
+  /* initialize the hardware */
+  low_level_init(netif);
+
+  return ERR_OK;
+}
+
+static net_addr_mode_t addressMode;
+static ip4_addr_t ip, gateway, netmask;
+static struct netif thisif;
+
+#if (defined(MAC_OFFLOADS_RX_CHECKSUM) && MAC_OFFLOADS_RX_CHECKSUM) || defined(__DOXYGEN__)
+#if IP_REASSEMBLY || defined(__DOXYGEN__)
+/*
+ * Verifies the transport checksum of a reassembled datagram, the MAC does
+ * not verify the payload of the fragments.
+ */
+static bool ip4_reass_chksum_ok(struct pbuf *p) {
+  const struct ip_hdr *iphdr = (const struct ip_hdr *)p->payload;
+  u16_t hlen = IPH_HL_BYTES(iphdr);
+  u8_t proto = IPH_PROTO(iphdr);
+  ip4_addr_t src, dest;
+  bool ok;
+
+  ip4_addr_copy(src, iphdr->src);
+  ip4_addr_copy(dest, iphdr->dest);
+  if (pbuf_remove_header(p, hlen) != 0U)
+    return false;
+
+  switch (proto) {
+  case IP_PROTO_UDP:
+    /* A zero UDP checksum is not verified, short datagrams are left to
+       udp_input().*/
+    ok = (p->len < UDP_HLEN) ||
+         (((const struct udp_hdr *)p->payload)->chksum == 0U) ||
+         (inet_chksum_pseudo(p, IP_PROTO_UDP, p->tot_len, &src, &dest) == 0U);
+    if (!ok)
+      UDP_STATS_INC(udp.chkerr);
+    break;
+  case IP_PROTO_TCP:
+    ok = inet_chksum_pseudo(p, IP_PROTO_TCP, p->tot_len, &src, &dest) == 0U;
+    if (!ok)
+      TCP_STATS_INC(tcp.chkerr);
+    break;
+  case IP_PROTO_ICMP:
+    ok = inet_chksum_pbuf(p) == 0U;
+    if (!ok)
+      ICMP_STATS_INC(icmp.chkerr);
+    break;
+  default:
+    ok = true;
+    break;
+  }
+  (void)pbuf_add_header_force(p, hlen);
+
+  return ok;
+}
+#endif
+
+/*
+ * IPv4 input hook, the fragments received on the MAC interface are
+ * reassembled here instead of ip4_input() so that the transport checksum
+ * of the datagram is verified before it is input again as a whole packet.
+ * The checksum controls of the interface are never changed.
+ */
+int lwip_ip4_input_hook(struct pbuf *p, struct netif *inp) {
+#if IP_REASSEMBLY
+  const struct ip_hdr *iphdr = (const struct ip_hdr *)p->payload;
+  u16_t hlen, len;
+
+  if ((inp != &thisif) ||
+      ((IPH_OFFSET(iphdr) & PP_HTONS(IP_OFFMASK | IP_MF)) == 0U))
+    return 0;
+
+  /* Malformed fragments are dropped by ip4_input().*/
+  hlen = IPH_HL_BYTES(iphdr);
+  len  = lwip_ntohs(IPH_LEN(iphdr));
+  if ((hlen < IP_HLEN) || (hlen > p->len) || (len > p->tot_len))
+    return 0;
+  if (len < p->tot_len)
+    pbuf_realloc(p, len);
+
+  p = ip4_reass(p);
+  if (p == NULL)
+    return 1;
+
+  if (!ip4_reass_chksum_ok(p)) {
+    IP_STATS_INC(ip.drop);
+    pbuf_free(p);
+    return 1;
+  }
+
+  (void)ip4_input(p, inp);
+
+  return 1;
+#else
+  (void)p;
+  (void)inp;
+
+  return 0;
+#endif
+}
+#endif
+
+void lwipDefaultLinkUpCB(void *p)
+{
+  struct netif *ifc = (struct netif*) p;
+  (void) ifc;
+#if LWIP_AUTOIP
+  if (addressMode == NET_ADDRESS_AUTO)
+    autoip_start(ifc);
+#endif
+#if LWIP_DHCP
+  if (addressMode == NET_ADDRESS_DHCP)
+    dhcp_start(ifc);
+#endif
+}
+
+void lwipDefaultLinkDownCB(void *p)
+{
+  struct netif *ifc = (struct netif*) p;
+  (void) ifc;
+#if LWIP_AUTOIP
+  if (addressMode == NET_ADDRESS_AUTO)
+    autoip_stop(ifc);
+#endif
+#if LWIP_DHCP
+  if (addressMode == NET_ADDRESS_DHCP)
+    dhcp_stop(ifc);
+#endif
+}
+
+/*
+ * Link state tracking.
+ */
+static struct {
+  thread_t                  *tp;
+  tcpip_callback_fn         up_cb;
+  tcpip_callback_fn         down_cb;
+#if LINK_USE_POLL_TIMER
+  virtual_timer_t           vt;
+#endif
+#if LWIP_LINK_FAST_POLL_COUNT > 0
+  unsigned                  fast_polls;
+#endif
+} link_state;
+
+#if LINK_USE_POLL_TIMER || defined(__DOXYGEN__)
+/*
+ * Link poll timer callback.
+ */
+static void link_vt_cb(virtual_timer_t *vtp, void *p) {
+
+  (void)vtp;
+  (void)p;
+
+  chSysLockFromISR();
+  chEvtSignalI(link_state.tp, LINK_EVENT_ID);
+  chSysUnlockFromISR();
+}
+#endif
+
+#if defined(LWIP_LINK_EVENT_LINE) || defined(__DOXYGEN__)
+/*
+ * PHY interrupt line callback.
+ */
+static void link_pal_cb(void *p) {
+
+  (void)p;
+
+  chSysLockFromISR();
+  chEvtSignalI(link_state.tp, LINK_EVENT_ID);
+  chSysUnlockFromISR();
+}
+#endif
+
+/*
+ * Polls the link status and notifies the changes to the stack.
+ */
+static void link_poll(void) {
+  bool current_link_status = macPollLinkStatus(&ETHD1);
+  bool changed = current_link_status != netif_is_link_up(&thisif);
+
+  if (changed) {
+#if LWIP_TCPIP_CORE_LOCKING
+    /* Called directly, the callbacks cannot be lost on a full mailbox.*/
+    LOCK_TCPIP_CORE();
+    if (current_link_status) {
+      netif_set_link_up(&thisif);
+      link_state.up_cb(&thisif);
+    }
+    else {
+      netif_set_link_down(&thisif);
+      link_state.down_cb(&thisif);
+    }
+    UNLOCK_TCPIP_CORE();
+#else
+    if (current_link_status) {
+      tcpip_callback_with_block((tcpip_callback_fn) netif_set_link_up,
+                                 &thisif, 0);
+      tcpip_callback_with_block(link_state.up_cb, &thisif, 0);
+    }
+    else {
+      tcpip_callback_with_block((tcpip_callback_fn) netif_set_link_down,
+                                 &thisif, 0);
+      tcpip_callback_with_block(link_state.down_cb, &thisif, 0);
+    }
+#endif
+  }
+
+#if LWIP_LINK_FAST_POLL_COUNT > 0
+#if defined(LWIP_LINK_EVENT_LINE)
+  /* The PHY interrupt reports the link coming up, fast polls only cover
+     the settling after a change.*/
+  if (changed)
+    link_state.fast_polls = LWIP_LINK_FAST_POLL_COUNT;
+#else
+  if (changed || !current_link_status)
+    link_state.fast_polls = LWIP_LINK_FAST_POLL_COUNT;
+#endif
+  if (link_state.fast_polls > 0U) {
+    link_state.fast_polls--;
+    chVTSet(&link_state.vt, LWIP_LINK_FAST_POLL_INTERVAL, link_vt_cb, NULL);
+    return;
+  }
+#endif
+#if !defined(LWIP_LINK_EVENT_LINE)
+  /* Without the PHY interrupt nothing reports a link loss, an established
+     link is polled continuously.*/
+  chVTSet(&link_state.vt, LWIP_LINK_UP_POLL_INTERVAL, link_vt_cb, NULL);
+#endif
+}
+
+#if (LWIP_FASTPATH_FLOWS > 0) || defined(__DOXYGEN__)
+/*
+ * Registered fast-path flows, accessed under the system lock.
+ */
+static lwip_fastpath_flow_t *fastpath_flows[LWIP_FASTPATH_FLOWS];
+
+/*
+ * Returns the flow matching a datagram or NULL.
+ */
+static lwip_fastpath_flow_t *fastpath_lookup_i(const ip4_addr_t *src,
+                                               u16_t sport, u16_t dport) {
+  unsigned i;
+
+  for (i = 0U; i < LWIP_FASTPATH_FLOWS; i++) {
+    lwip_fastpath_flow_t *fp = fastpath_flows[i];
+
+    if ((fp != NULL) && (fp->port == dport) &&
+        ((fp->remote_port == 0U) || (fp->remote_port == sport)) &&
+        (ip4_addr_isany_val(fp->remote_address) ||
+         ip4_addr_cmp(&fp->remote_address, src)))
+      return fp;
+  }
+
+  return NULL;
+}
+
+/*
+ * Delivers a received frame to the matching fast-path flow. Only
+ * unfragmented IPv4 UDP datagrams addressed to the interface, with the
+ * headers in the first pbuf, are considered. Returns true if the frame
+ * has been consumed, either queued or dropped because the flow FIFO is
+ * full, false if it has to be processed by the stack.
+ */
+static bool fastpath_input(struct netif *netif, struct pbuf *p) {
+  const struct eth_hdr *ethhdr = p->payload;
+  const struct ip_hdr *iphdr;
+  const struct udp_hdr *udphdr;
+  lwip_fastpath_flow_t *fp;
+  lwip_fastpath_dgram_t *dgp;
+  ip4_addr_t src, dst;
+  u16_t iphlen, iplen, udplen, sport, dport;
+  uint64_t rx_time;
+
+  if ((ethhdr->type != PP_HTONS(ETHTYPE_IP)) ||
+      (p->len < SIZEOF_ETH_HDR + IP_HLEN))
+    return false;
+
+  iphdr  = (const struct ip_hdr *)((const u8_t *)p->payload + SIZEOF_ETH_HDR);
+  iphlen = IPH_HL_BYTES(iphdr);
+  iplen  = lwip_ntohs(IPH_LEN(iphdr));
+  if ((IPH_V(iphdr) != 4U) || (IPH_PROTO(iphdr) != IP_PROTO_UDP) ||
+      ((IPH_OFFSET(iphdr) & PP_HTONS(IP_OFFMASK | IP_MF)) != 0U) ||
+      (iphlen < IP_HLEN) || (p->len < SIZEOF_ETH_HDR + iphlen + UDP_HLEN) ||
+      (iplen < iphlen + UDP_HLEN) || (iplen > p->tot_len - SIZEOF_ETH_HDR))
+    return false;
+
+  ip4_addr_copy(src, iphdr->src);
+  ip4_addr_copy(dst, iphdr->dest);
+  if (!ip4_addr_cmp(&dst, netif_ip4_addr(netif)))
+    return false;
+
+  udphdr = (const struct udp_hdr *)((const u8_t *)iphdr + iphlen);
+  udplen = lwip_ntohs(udphdr->len);
+  sport  = lwip_ntohs(udphdr->src);
+  dport  = lwip_ntohs(udphdr->dest);
+  if ((udplen < UDP_HLEN) || (udplen > iplen - iphlen))
+    return false;
+
+  /* Cheap check before the checksums, the lookup is repeated on
+     delivery.*/
+  osalSysLock();
+  fp = fastpath_lookup_i(&src, sport, dport);
+  osalSysUnlock();
+  if (fp == NULL)
+    return false;
+  rx_time = mclkGetMicrosecondsX();
+
+#if CHECKSUM_CHECK_IP
+  /* Datagrams with errors are left to the stack, it drops and counts
+     them.*/
+  IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_CHECK_IP) {
+    if (inet_chksum(iphdr, iphlen) != 0U)
+      return false;
+  }
+#endif
+
+  /* The pbuf is moved to the UDP header, the Ethernet padding is
+     removed.*/
+  pbuf_remove_header(p, SIZEOF_ETH_HDR + iphlen);
+  pbuf_realloc(p, udplen);
+
+#if CHECKSUM_CHECK_UDP
+  IF__NETIF_CHECKSUM_ENABLED(netif, NETIF_CHECKSUM_CHECK_UDP) {
+    if ((udphdr->chksum != 0U) &&
+        (inet_chksum_pseudo(p, IP_PROTO_UDP, udplen, &src, &dst) != 0U)) {
+      pbuf_add_header_force(p, SIZEOF_ETH_HDR + iphlen);
+      return false;
+    }
+  }
+#endif
+
+  pbuf_remove_header(p, UDP_HLEN);
+
+  osalSysLock();
+  fp = fastpath_lookup_i(&src, sport, dport);
+  if (fp == NULL) {
+    /* Unregistered meanwhile.*/
+    osalSysUnlock();
+    pbuf_add_header_force(p, SIZEOF_ETH_HDR + iphlen + UDP_HLEN);
+    return false;
+  }
+  dgp = chFifoTakeObjectI(fp->ofp);
+  if (dgp == NULL) {
+    fp->dropped++;
+    osalSysUnlock();
+    pbuf_free(p);
+    return true;
+  }
+  dgp->p        = p;
+  dgp->src_addr = src;
+  dgp->src_port = sport;
+  dgp->rx_time  = rx_time;
+  fp->delivered++;
+  chFifoSendObjectS(fp->ofp, dgp);
+  osalSysUnlock();
+
+  return true;
+}
+#endif
+
+#if LWIP_LOOPBACK_NETIF || defined(__DOXYGEN__)
+/*
+ * Custom pbuf referencing the payload of a looped back packet, it holds a
+ * reference to the sent pbuf.
+ */
+typedef struct loop_pbuf {
+  struct pbuf_custom    pc;
+  struct pbuf           *ref;
+} loop_pbuf_t;
+
+static loop_pbuf_t loop_pbufs[LWIP_LOOPBACK_PBUFS];
+static MEMORYPOOL_DECL(loop_pbuf_pool, sizeof (loop_pbuf_t),
+                       PORT_NATURAL_ALIGN, NULL);
+
+/*
+ * Packets waiting for the tcpip thread, accessed under the system lock.
+ */
+static struct {
+  struct pbuf               *packets[LWIP_LOOPBACK_QUEUE_SIZE];
+  unsigned                  rd;
+  unsigned                  cnt;
+  bool                      posted;
+  struct tcpip_callback_msg *msg;
+} loop_queue;
+
+static struct netif loopif;
+
+/*
+ * Releases the reference to the sent pbuf, it can be called from any
+ * thread.
+ */
+static void loop_pbuf_free(struct pbuf *p) {
+  loop_pbuf_t *lp = (loop_pbuf_t *)p;
+  struct pbuf *ref = lp->ref;
+
+  chPoolFree(&loop_pbuf_pool, lp);
+  pbuf_free(ref);
+}
+
+/*
+ * Length of the IPv4 and transport headers of a packet, the stack modifies
+ * them in place on reception.
+ */
+static u16_t loop_header_length(struct pbuf *p) {
+  u16_t len = (u16_t)((pbuf_get_at(p, 0) & 0x0FU) * 4U);
+
+  /* Transport header in the first or only fragment.*/
+  if (((pbuf_get_at(p, 6) & 0x1FU) == 0U) && (pbuf_get_at(p, 7) == 0U)) {
+    switch (pbuf_get_at(p, 9)) {
+    case IP_PROTO_UDP:
+      len += UDP_HLEN;
+      break;
+    case IP_PROTO_TCP:
+      len += (u16_t)((pbuf_get_at(p, len + 12U) >> 4) * 4U);
+      break;
+    case IP_PROTO_ICMP:
+      len += (u16_t)sizeof (struct icmp_echo_hdr);
+      break;
+    default:
+      break;
+    }
+  }
+
+  return len < p->tot_len ? len : p->tot_len;
+}
+
+/*
+ * Makes the pbuf chain delivered for a sent packet. The headers are copied,
+ * the payload is referenced unless the sender can modify it after the
+ * output returns or the custom pbufs are exhausted.
+ */
+static struct pbuf *loop_pbuf_wrap(struct pbuf *p) {
+  struct pbuf *r, *q;
+  u16_t hlen, off;
+
+  for (q = p; q != NULL; q = q->next) {
+    if (PBUF_NEEDS_COPY(q))
+      return pbuf_clone(PBUF_LINK, PBUF_RAM, p);
+  }
+
+  hlen = loop_header_length(p);
+  r = pbuf_alloc(PBUF_LINK, hlen, PBUF_RAM);
+  if (r == NULL)
+    return NULL;
+  pbuf_copy_partial(p, r->payload, hlen, 0);
+
+  for (q = p, off = hlen; q != NULL; q = q->next) {
+    loop_pbuf_t *lp;
+
+    if (off >= q->len) {
+      off -= q->len;
+      continue;
+    }
+    lp = chPoolAlloc(&loop_pbuf_pool);
+    if (lp == NULL) {
+      pbuf_free(r);
+      return pbuf_clone(PBUF_LINK, PBUF_RAM, p);
+    }
+    pbuf_ref(p);
+    lp->ref = p;
+    lp->pc.custom_free_function = loop_pbuf_free;
+    pbuf_cat(r, pbuf_alloced_custom(PBUF_RAW, q->len - off, PBUF_REF,
+                                    &lp->pc, (u8_t *)q->payload + off,
+                                    q->len - off));
+    off = 0U;
+  }
+
+  return r;
+}
+
+/*
+ * Delivers the queued packets, called by the tcpip thread. Packets sent
+ * while processing are delivered too.
+ */
+static void loop_input(void *ctx) {
+
+  (void)ctx;
+
+  while (true) {
+    struct pbuf *p;
+
+    osalSysLock();
+    if (loop_queue.cnt == 0U) {
+      loop_queue.posted = false;
+      osalSysUnlock();
+      return;
+    }
+    p = loop_queue.packets[loop_queue.rd];
+    loop_queue.rd = (loop_queue.rd + 1U) % LWIP_LOOPBACK_QUEUE_SIZE;
+    loop_queue.cnt--;
+    osalSysUnlock();
+
+    LINK_STATS_INC(link.recv);
+    MIB2_STATS_NETIF_ADD(&loopif, ifinoctets, p->tot_len);
+    MIB2_STATS_NETIF_INC(&loopif, ifinucastpkts);
+    if (loopif.input(p, &loopif) != ERR_OK)
+      pbuf_free(p);
+  }
+}
+
+/*
+ * Output function of the loopback interface, called with the core locked.
+ * The packet is queued and delivered later by the tcpip thread, as done by
+ * the lwIP loopback, so that the stack is not re-entered.
+ */
+static err_t loop_output(struct netif *netif, struct pbuf *p,
+                         const ip4_addr_t *ipaddr) {
+  struct pbuf *r;
+  bool queued, post = false;
+
+  (void)ipaddr;
+
+  r = loop_pbuf_wrap(p);
+  if (r == NULL) {
+    LINK_STATS_INC(link.memerr);
+    LINK_STATS_INC(link.drop);
+    MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+    return ERR_MEM;
+  }
+
+  osalSysLock();
+  queued = loop_queue.cnt < LWIP_LOOPBACK_QUEUE_SIZE;
+  if (queued) {
+    loop_queue.packets[(loop_queue.rd + loop_queue.cnt) %
+                       LWIP_LOOPBACK_QUEUE_SIZE] = r;
+    loop_queue.cnt++;
+    post = !loop_queue.posted;
+    loop_queue.posted = true;
+  }
+  osalSysUnlock();
+
+  if (!queued) {
+    pbuf_free(r);
+    LINK_STATS_INC(link.drop);
+    MIB2_STATS_NETIF_INC(netif, ifoutdiscards);
+    return ERR_MEM;
+  }
+
+  /* If the mailbox is full the next packet retries.*/
+  if (post && (tcpip_callbackmsg_trycallback(loop_queue.msg) != ERR_OK)) {
+    osalSysLock();
+    loop_queue.posted = false;
+    osalSysUnlock();
+  }
+
+  LINK_STATS_INC(link.xmit);
+  MIB2_STATS_NETIF_ADD(netif, ifoutoctets, p->tot_len);
+  MIB2_STATS_NETIF_INC(netif, ifoutucastpkts);
+
+  return ERR_OK;
+}
 
-  if (macWaitReceiveDescriptor(&ETHD1, &rd, TIME_IMMEDIATE) != MSG_OK)
-    return false;
+/*
+ * Initializes the loopback interface.
+ */
+static err_t loopif_init(struct netif *netif) {
 
-  len = (u16_t)rd.size;
+  MIB2_INIT_NETIF(netif, snmp_ifType_softwareLoopback, 0);
 
-#if ETH_PAD_SIZE
-  len += ETH_PAD_SIZE;        /* allow room for Ethernet padding */
+  netif->name[0] = 'l';
+  netif->name[1] = 'o';
+#if LWIP_CHECKSUM_CTRL_PER_NETIF
+  NETIF_SET_CHECKSUM_CTRL(netif, NETIF_CHECKSUM_DISABLE_ALL);
 #endif
+  netif->output = loop_output;
 
-  /* We allocate a pbuf chain of pbufs from the pool. */
-  *pbuf = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
-
-  if (*pbuf != NULL) {
-#if ETH_PAD_SIZE
-    pbuf_header(*pbuf, -ETH_PAD_SIZE); /* drop the padding word */
+  return ERR_OK;
+}
 #endif
 
-    /* Iterates through the pbuf chain. */
-    for(q = *pbuf; q != NULL; q = q->next)
-      macReadReceiveDescriptor(&rd, (uint8_t *)q->payload, (size_t)q->len);
-    macReleaseReceiveDescriptorX(&rd);
+#if (RX_BATCH_SIZE > 0) || defined(__DOXYGEN__)
+/*
+ * Receive hand-off queue, the frames are taken by the tcpip thread in
+ * order. Accessed under the system lock.
+ */
+static struct {
+  struct pbuf               *frames[RX_BATCH_SIZE];
+  unsigned                  rd;
+  unsigned                  cnt;
+  bool                      posted;
+  bool                      stalled;
+  bool                      deferred;
+  struct tcpip_callback_msg *msg;
+} rx_batch;
 
-    MIB2_STATS_NETIF_ADD(netif, ifinoctets, (*pbuf)->tot_len);
+/*
+ * Processes the queued frames, called by the tcpip thread. At most one
+ * queue worth of frames is processed for each message, the message is
+ * posted again if more frames are waiting so that the other messages
+ * are served.
+ */
+static void rx_batch_input(void *ctx) {
+  unsigned n;
+  bool wakeup;
 
-    if (*(uint8_t *)((*pbuf)->payload) & 1) {
-      /* broadcast or multicast packet*/
-      MIB2_STATS_NETIF_INC(netif, ifinnucastpkts);
-    } 
-    else {
-      /* unicast packet*/
-      MIB2_STATS_NETIF_INC(netif, ifinucastpkts);
-    }
+  (void)ctx;
 
-#if ETH_PAD_SIZE
-    pbuf_header(*pbuf, ETH_PAD_SIZE); /* reclaim the padding word */
-#endif
+  for (n = 0U; n < RX_BATCH_SIZE; n++) {
+    struct pbuf *p;
 
-    LINK_STATS_INC(link.recv);
+    osalSysLock();
+    if (rx_batch.cnt == 0U) {
+      rx_batch.posted = false;
+      osalSysUnlock();
+      return;
+    }
+    p = rx_batch.frames[rx_batch.rd];
+    rx_batch.rd = (rx_batch.rd + 1U) % RX_BATCH_SIZE;
+    rx_batch.cnt--;
+    wakeup = rx_batch.stalled;
+    rx_batch.stalled = false;
+    osalSysUnlock();
+
+    /* The driver thread stopped draining the MAC on a full queue.*/
+    if (wakeup)
+      chEvtSignal(link_state.tp, FRAME_RECEIVED_ID);
+
+    if (ethernet_input(p, &thisif) != ERR_OK)
+      pbuf_free(p);
   }
-  else {
-    macReleaseReceiveDescriptorX(&rd);     // Drop packet
-    LINK_STATS_INC(link.memerr);
-    LINK_STATS_INC(link.drop);
-    MIB2_STATS_NETIF_INC(netif, ifindiscards);
+
+  /* More frames are waiting, if the mailbox is full the driver thread
+     posts the message again once a message has been taken.*/
+  if (tcpip_callbackmsg_trycallback(rx_batch.msg) != ERR_OK) {
+    osalSysLock();
+    rx_batch.posted = false;
+    rx_batch.deferred = true;
+    osalSysUnlock();
   }
-  
-  return true;
 }
 
 /*
- * Called at the beginning of the program to set up the
- * network interface. It calls the function low_level_init() to do the
- * actual setup of the hardware.
- *
- * This function should be passed as a parameter to netifapi_netif_add().
- *
- * @param netif the lwip network interface structure for this ethernetif
- * @return ERR_OK if the loopif is initialised
- *         ERR_MEM if private data couldn't be allocated
- *         any other err_t on error
+ * Checks for space in the queue before taking a frame from the MAC, the
+ * tcpip thread wakes up the driver thread when space is made.
  */
-static err_t ethernetif_init(struct netif *netif) {
-  osalDbgAssert((netif != NULL), "netif != NULL");
+static bool rx_batch_reserve(void) {
+  bool space;
+
+  osalSysLock();
+  space = rx_batch.cnt < RX_BATCH_SIZE;
+  if (!space) {
+    rx_batch.stalled = true;
+    rx_stats.batch_stalls++;
+  }
+  osalSysUnlock();
 
-  /*
-   * Initialize the snmp variables and counters inside the struct netif.
-   * The last argument should be replaced with your link speed, in units
-   * of bits per second.
-   */
-  MIB2_INIT_NETIF(netif, snmp_ifType_ethernet_csmacd, LWIP_LINK_SPEED);
+  return space;
+}
 
-  netif->state = NULL;
-  netif->name[0] = LWIP_IFNAME0;
-  netif->name[1] = LWIP_IFNAME1;
-  /* We directly use etharp_output() here to save a function call.
-   * You can instead declare your own function an call etharp_output()
-   * from it if you have to do some checks before sending (e.g. if link
-   * is available...) */
-  netif->output = etharp_output;
-  netif->linkoutput = low_level_output;
+/*
+ * Queues a frame, space has been checked by rx_batch_reserve().
+ */
+static void rx_batch_put(struct pbuf *p) {
 
-  /* initialize the hardware */
-  low_level_init(netif);
+  osalSysLock();
+  rx_batch.frames[(rx_batch.rd + rx_batch.cnt) % RX_BATCH_SIZE] = p;
+  rx_batch.cnt++;
+  osalSysUnlock();
+}
 
-  return ERR_OK;
+/*
+ * Posts the queued frames to the tcpip thread unless a message is already
+ * pending. On a full mailbox the frames stay queued, the post is retried
+ * when the tcpip thread has taken a message, the next frames are kept in
+ * the MAC meanwhile.
+ */
+static void rx_batch_post(void) {
+  bool post;
+
+  osalSysLock();
+  post = (rx_batch.cnt > 0U) && !rx_batch.posted;
+  if (post) {
+    rx_batch.posted = true;
+    rx_stats.batches++;
+  }
+  osalSysUnlock();
+
+  if (post && (tcpip_callbackmsg_trycallback(rx_batch.msg) != ERR_OK)) {
+    osalSysLock();
+    rx_batch.posted = false;
+    rx_batch.deferred = true;
+    rx_stats.batch_deferred++;
+    osalSysUnlock();
+  }
 }
+#endif
 
-static net_addr_mode_t addressMode;
-static ip4_addr_t ip, gateway, netmask;
-static struct netif thisif;
+/*
+ * tcpip thread loop hook, a message has been taken from the mailbox since
+ * a failed post of the received frames, the driver thread posts them
+ * again.
+ */
+void lwip_tcpip_thread_alive(void) {
+#if RX_BATCH_SIZE > 0
+  bool repost;
 
-void lwipDefaultLinkUpCB(void *p)
-{
-  struct netif *ifc = (struct netif*) p;
-  (void) ifc;
-#if LWIP_AUTOIP
-  if (addressMode == NET_ADDRESS_AUTO)
-    autoip_start(ifc);
-#endif
-#if LWIP_DHCP
-  if (addressMode == NET_ADDRESS_DHCP)
-    dhcp_start(ifc);
-#endif
-}
+  osalSysLock();
+  repost = rx_batch.deferred;
+  rx_batch.deferred = false;
+  osalSysUnlock();
 
-void lwipDefaultLinkDownCB(void *p)
-{
-  struct netif *ifc = (struct netif*) p;
-  (void) ifc;
-#if LWIP_AUTOIP
-  if (addressMode == NET_ADDRESS_AUTO)
-    autoip_stop(ifc);
-#endif
-#if LWIP_DHCP
-  if (addressMode == NET_ADDRESS_DHCP)
-    dhcp_stop(ifc);
+  if (repost)
+    chEvtSignal(link_state.tp, FRAME_RECEIVED_ID);
 #endif
 }
 
@@ -307,10 +1970,11 @@ void lwipDefaultLinkDownCB(void *p)
 static THD_FUNCTION(lwip_thread, p) {
   event_timer_t evt;
   event_listener_t el0, el1;
+#if MAC_USE_SCATTER_GATHER
+  event_listener_t el2;
+#endif
   static const MACConfig mac_config = {thisif.hwaddr};
   err_t result;
-  tcpip_callback_fn link_up_cb = NULL;
-  tcpip_callback_fn link_down_cb = NULL;
 
   chRegSetThreadName(LWIP_THREAD_NAME);
 
@@ -331,8 +1995,8 @@ static THD_FUNCTION(lwip_thread, p) {
 #if LWIP_NETIF_HOSTNAME
     thisif.hostname = opts->ourHostName;
 #endif
-    link_up_cb = opts->link_up_cb;
-    link_down_cb = opts->link_down_cb;
+    link_state.up_cb = opts->link_up_cb;
+    link_state.down_cb = opts->link_down_cb;
   }
   else {
     thisif.hwaddr[0] = LWIP_ETHADDR_0;
@@ -356,16 +2020,36 @@ static THD_FUNCTION(lwip_thread, p) {
 #endif
   }
 
-  if (!link_up_cb)
-    link_up_cb = lwipDefaultLinkUpCB;
-  if (!link_down_cb)
-    link_down_cb = lwipDefaultLinkDownCB;
+  if (!link_state.up_cb)
+    link_state.up_cb = lwipDefaultLinkUpCB;
+  if (!link_state.down_cb)
+    link_state.down_cb = lwipDefaultLinkDownCB;
 
 #if LWIP_NETIF_HOSTNAME
   if (thisif.hostname == NULL)
     thisif.hostname = LWIP_NETIF_HOSTNAME_STRING;
 #endif
 
+#if MAC_USE_ZERO_COPY
+  chPoolLoadArray(&rx_pbuf_pool, rx_pbufs, LWIP_MAC_RX_PBUFS);
+#endif
+
+#if LWIP_OCCUPANCY_STATS
+  macOccupancyObjectInit(&occupancy.rx_pbufs, LWIP_MAC_RX_PBUFS);
+  macOccupancyObjectInit(&occupancy.pbuf_pool, PBUF_POOL_SIZE);
+#endif
+
+#if RX_BATCH_SIZE > 0
+  /* The message is allocated once and reused for all the batches.*/
+  rx_batch.msg = tcpip_callbackmsg_new(rx_batch_input, NULL);
+  if (rx_batch.msg == NULL)
+    osalSysHalt("rx batch message allocation error");
+#endif
+
+#if LWIP_MAC_TX_QUEUE_SIZE > 0
+  macSetCallbackX(&ETHD1, tx_queue_cb);
+#endif
+
   macStart(&ETHD1, &mac_config);
 
   MIB2_INIT_NETIF(&thisif, snmp_ifType_ethernet_csmacd, 0);
@@ -381,13 +2065,47 @@ static THD_FUNCTION(lwip_thread, p) {
   netifapi_netif_set_default(&thisif);
   netifapi_netif_set_up(&thisif);
 
+#if LWIP_LOOPBACK_NETIF
+  {
+    ip4_addr_t loop_ip, loop_netmask;
+
+    chPoolLoadArray(&loop_pbuf_pool, loop_pbufs, LWIP_LOOPBACK_PBUFS);
+    loop_queue.msg = tcpip_callbackmsg_new(loop_input, NULL);
+    if (loop_queue.msg == NULL)
+      osalSysHalt("loopback message allocation error");
+
+    /* Packets are delivered by the tcpip thread, directly to the IP
+       layer.*/
+    IP4_ADDR(&loop_ip, 127, 0, 0, 1);
+    IP4_ADDR(&loop_netmask, 255, 0, 0, 0);
+    result = netifapi_netif_add(&loopif, &loop_ip, &loop_netmask, &loop_ip,
+                                NULL, loopif_init, ip_input);
+    if (result != ERR_OK)
+      osalSysHalt("loopback netif_add error");
+    netifapi_netif_set_link_up(&loopif);
+    netifapi_netif_set_up(&loopif);
+  }
+#endif
+
   /* Setup event sources.*/
   evtObjectInit(&evt, LWIP_LINK_POLL_INTERVAL);
   evtStart(&evt);
   chEvtRegisterMask(&evt.et_es, &el0, PERIODIC_TIMER_ID);
   chEvtRegisterMaskWithFlags(macGetEventSource(&ETHD1), &el1,
                                                FRAME_RECEIVED_ID, MAC_FLAGS_RX);
-  chEvtAddEvents(PERIODIC_TIMER_ID | FRAME_RECEIVED_ID);
+#if MAC_USE_SCATTER_GATHER
+  chEvtRegisterMaskWithFlags(macGetEventSource(&ETHD1), &el2,
+                                               FRAME_TRANSMITTED_ID, MAC_FLAGS_TX);
+#endif
+  link_state.tp = chThdGetSelfX();
+#if LINK_USE_POLL_TIMER
+  chVTObjectInit(&link_state.vt);
+#endif
+#if defined(LWIP_LINK_EVENT_LINE)
+  palSetLineCallback(LWIP_LINK_EVENT_LINE, link_pal_cb, NULL);
+  palEnableLineEvent(LWIP_LINK_EVENT_LINE, LWIP_LINK_EVENT_MODE);
+#endif
+  chEvtAddEvents(PERIODIC_TIMER_ID | FRAME_RECEIVED_ID | LINK_EVENT_ID);
 
   /* Resumes the caller and goes to the final priority.*/
   chThdResume(&lwip_trp, MSG_OK);
@@ -396,40 +2114,115 @@ static THD_FUNCTION(lwip_thread, p) {
   while (true) {
     eventmask_t mask = chEvtWaitAny(ALL_EVENTS);
     if (mask & PERIODIC_TIMER_ID) {
-      bool current_link_status = macPollLinkStatus(&ETHD1);
-      if (current_link_status != netif_is_link_up(&thisif)) {
-        if (current_link_status) {
-          tcpip_callback_with_block((tcpip_callback_fn) netif_set_link_up,
-                                     &thisif, 0);
-          tcpip_callback_with_block(link_up_cb, &thisif, 0);
-        }
-        else {
-          tcpip_callback_with_block((tcpip_callback_fn) netif_set_link_down,
-                                     &thisif, 0);
-          tcpip_callback_with_block(link_down_cb, &thisif, 0);
-        }
+#if MAC_USE_STATISTICS
+      {
+        macstatistics_t ms;
+
+        /* Periodic collection keeps the hardware counters from wrapping.*/
+        macGetStatistics(&ETHD1, &ms);
       }
+#endif
+#if LWIP_MAC_TX_QUEUE_SIZE > 0
+      /* Frames queued while the link was down.*/
+      osalSysLock();
+      (void)tx_queue_drain_i();
+      osalSysUnlock();
+#endif
+#if LWIP_OCCUPANCY_STATS
+      occupancy_dump();
+#endif
+    }
+
+    if (mask & LINK_EVENT_ID) {
+      link_poll();
+    }
+
+#if MAC_USE_SCATTER_GATHER
+    if (mask & FRAME_TRANSMITTED_ID) {
+      /* Releasing the pbufs referenced by the transmitted frames.*/
+      low_level_tx_reclaim();
+#if LWIP_MAC_TX_QUEUE_SIZE > 0
+      /* The interrupt refill stops when too many cookies are waiting to be
+         reclaimed, it is resumed here.*/
+      osalSysLock();
+      (void)tx_queue_drain_i();
+      osalSysUnlock();
+#endif
     }
+#endif
 
     if (mask & FRAME_RECEIVED_ID) {
       struct pbuf *p;
-      while (low_level_input(&thisif, &p)) {
+      unsigned budget = LWIP_RX_POLL_BUDGET;
+
+      rx_stats.polls++;
+#if LWIP_TCPIP_CORE_LOCKING
+      /* The frames are processed inline, the core is locked once for the
+         whole poll.*/
+      LOCK_TCPIP_CORE();
+#endif
+      while (true) {
+        if (budget == 0U) {
+          /* Budget exhausted, the ring is polled again after serving the
+             other events.*/
+          rx_stats.budget_exhausted++;
+          chEvtAddEvents(FRAME_RECEIVED_ID);
+          break;
+        }
+#if RX_BATCH_SIZE > 0
+        /* Frames are left in the MAC while the queue is full.*/
+        if (!rx_batch_reserve())
+          break;
+#endif
+        if (!low_level_input(&thisif, &p))
+          break;
+        budget--;
+        rx_stats.frames++;
+
         if (p != NULL) {
           struct eth_hdr *ethhdr = p->payload;
+#if LWIP_FASTPATH_FLOWS > 0
+          /* Selected UDP flows bypass the stack.*/
+          if (fastpath_input(&thisif, p)) {
+            rx_stats.fastpath++;
+            continue;
+          }
+#endif
           switch (htons(ethhdr->type)) {
             /* IP or ARP packet? */
             case ETHTYPE_IP:
             case ETHTYPE_ARP:
+#if LWIP_TCPIP_CORE_LOCKING
+              /* Processed inline, the pbuf is consumed in any case.*/
+              ethernet_input(p, &thisif);
+              break;
+#elif RX_BATCH_SIZE > 0
+              /* Queued, the whole batch is sent to tcpip_thread.*/
+              rx_batch_put(p);
+              break;
+#else
               /* full packet send to tcpip_thread to process */
               if (thisif.input(p, &thisif) == ERR_OK)
                 break;
               LWIP_DEBUGF(NETIF_DEBUG, ("ethernetif_input: IP input error\n"));
+#endif
           /* Falls through */
             default:
               pbuf_free(p);
           }
         }
       }
+#if LWIP_TCPIP_CORE_LOCKING
+      UNLOCK_TCPIP_CORE();
+#endif
+#if RX_BATCH_SIZE > 0
+      rx_batch_post();
+#endif
+#if LWIP_OCCUPANCY_STATS
+      osalSysLock();
+      pbuf_pool_sample_i();
+      osalSysUnlock();
+#endif
     }
   }
 }
@@ -524,8 +2317,304 @@ void lwipReconfigure(const lwipreconf_opts_t *opts)
   lwip_reconf_params_t params;
   params.opts = opts;
   chSemObjectInit(&params.completion, 0);
-  tcpip_callback_with_block(do_reconfigure, &params, 0);
+#if LWIP_TCPIP_CORE_LOCKING
+  LOCK_TCPIP_CORE();
+  do_reconfigure(&params);
+  UNLOCK_TCPIP_CORE();
+#else
+  /* Not waiting for a callback that could not be posted.*/
+  if (tcpip_callback_with_block(do_reconfigure, &params, 1) != ERR_OK)
+    return;
+#endif
   chSemWait(&params.completion);
 }
 
+/**
+ * @brief   Returns the receive polling statistics.
+ *
+ * @param[out] stats    pointer to the statistics to be filled
+ */
+void lwipGetRxStats(lwip_rx_stats_t *stats)
+{
+  osalSysLock();
+  *stats = rx_stats;
+  osalSysUnlock();
+}
+
+#if (LWIP_FASTPATH_FLOWS > 0) || defined(__DOXYGEN__)
+/**
+ * @brief   Registers a fast-path UDP flow.
+ * @details The matching datagrams are queued by the lwIP thread into the
+ *          flow objects FIFO, bypassing the tcpip thread, as
+ *          @p lwip_fastpath_dgram_t objects. The receiver owns the pbufs and
+ *          must free them with @p pbuf_free().
+ * @note    A socket bound to the same port does not receive the matching
+ *          datagrams. ARP, ICMP and the datagrams that fail the checks are
+ *          still processed by the stack.
+ * @note    In zero-copy mode the pbufs hold MAC receive buffers, they
+ *          should be freed without delay.
+ *
+ * @param[in] fp        pointer to the flow, the counters are reset
+ * @return              The operation status.
+ * @retval MSG_OK       if the flow has been registered.
+ * @retval MSG_RESET    if all the @p LWIP_FASTPATH_FLOWS slots are in use.
+ *
+ * @api
+ */
+msg_t lwipFastPathRegister(lwip_fastpath_flow_t *fp)
+{
+  msg_t msg = MSG_RESET;
+  unsigned i;
+
+  osalDbgCheck((fp != NULL) && (fp->port != 0U) && (fp->ofp != NULL));
+  osalDbgAssert(fp->ofp->free.pool.object_size >= sizeof (lwip_fastpath_dgram_t),
+                "objects too small");
+
+  fp->delivered = 0U;
+  fp->dropped   = 0U;
+
+  osalSysLock();
+  for (i = 0U; i < LWIP_FASTPATH_FLOWS; i++) {
+    if (fastpath_flows[i] == NULL) {
+      fastpath_flows[i] = fp;
+      msg = MSG_OK;
+      break;
+    }
+  }
+  osalSysUnlock();
+
+  return msg;
+}
+
+/**
+ * @brief   Unregisters a fast-path UDP flow.
+ * @note    The datagrams already in the FIFO are not removed, the receiver
+ *          still has to free them.
+ *
+ * @param[in] fp        pointer to the flow
+ *
+ * @api
+ */
+void lwipFastPathUnregister(lwip_fastpath_flow_t *fp)
+{
+  unsigned i;
+
+  osalDbgCheck(fp != NULL);
+
+  osalSysLock();
+  for (i = 0U; i < LWIP_FASTPATH_FLOWS; i++) {
+    if (fastpath_flows[i] == fp) {
+      fastpath_flows[i] = NULL;
+    }
+  }
+  osalSysUnlock();
+}
+#endif
+
+#if LWIP_RX_PRIORITY || defined(__DOXYGEN__)
+/**
+ * @brief   Sets the receive priority port rules.
+ * @details The rules are matched in order against the destination port of
+ *          the received TCP and UDP datagrams, the first matching rule gives
+ *          the class of the frame regardless of its VLAN priority and DSCP.
+ *
+ * @param[in] rules     array of rules, it is copied
+ * @param[in] n         number of rules, up to @p LWIP_RX_RULES, zero
+ *                      removes all the rules
+ *
+ * @api
+ */
+void lwipSetRxRules(const lwip_rx_rule_t *rules, unsigned n)
+{
+  unsigned i;
+
+  osalDbgCheck((n <= LWIP_RX_RULES) && ((n == 0U) || (rules != NULL)));
+
+  osalSysLock();
+  for (i = 0U; i < n; i++) {
+    osalDbgCheck(rules[i].cls < LWIP_RX_CLASSES);
+    rx_rules[i] = rules[i];
+  }
+  rx_rules_n = n;
+  osalSysUnlock();
+}
+#endif
+
+/**
+ * @brief   Returns a snapshot of the network interface statistics.
+ * @details MAC hardware, driver and lwIP counters are collected in a single
+ *          structure, drops can be told apart by where they happen:
+ *          - MAC receive FIFO: @p mac.rx_fifo_overflows.
+ *          - Descriptors ring: @p mac.rx_missed_frames.
+ *          - Pbuf allocation: @p link.memerr.
+ *          .
+ * @note    The lwIP counters are read without locking the stack.
+ *
+ * @param[out] stats    pointer to the statistics to be filled
+ */
+void lwipGetInterfaceStats(lwip_ifstats_t *stats)
+{
+  memset(stats, 0, sizeof (*stats));
+
+#if MAC_USE_STATISTICS
+  macGetStatistics(&ETHD1, &stats->mac);
+#endif
+  lwipGetRxStats(&stats->rx);
+#if LWIP_MAC_TX_QUEUE_SIZE > 0
+  lwipGetTxQueueStats(&stats->txq);
+#endif
+
+#if LINK_STATS
+  stats->link.xmit   = lwip_stats.link.xmit;
+  stats->link.recv   = lwip_stats.link.recv;
+  stats->link.drop   = lwip_stats.link.drop;
+  stats->link.memerr = lwip_stats.link.memerr;
+  stats->link.err    = lwip_stats.link.err;
+#endif
+
+#if MIB2_STATS
+  stats->mib2.ifinoctets      = thisif.mib2_counters.ifinoctets;
+  stats->mib2.ifinucastpkts   = thisif.mib2_counters.ifinucastpkts;
+  stats->mib2.ifinnucastpkts  = thisif.mib2_counters.ifinnucastpkts;
+  stats->mib2.ifindiscards    = thisif.mib2_counters.ifindiscards;
+  stats->mib2.ifoutoctets     = thisif.mib2_counters.ifoutoctets;
+  stats->mib2.ifoutucastpkts  = thisif.mib2_counters.ifoutucastpkts;
+  stats->mib2.ifoutnucastpkts = thisif.mib2_counters.ifoutnucastpkts;
+  stats->mib2.ifoutdiscards   = thisif.mib2_counters.ifoutdiscards;
+#endif
+}
+
+#if (LWIP_MAC_TX_QUEUE_SIZE > 0) || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the software transmit queue statistics.
+ *
+ * @param[out] stats    pointer to the statistics to be filled
+ */
+void lwipGetTxQueueStats(lwip_txq_stats_t *stats)
+{
+  osalSysLock();
+  *stats = tx_queue_stats;
+  osalSysUnlock();
+}
+#endif
+
+#if LWIP_OCCUPANCY_STATS || defined(__DOXYGEN__)
+/**
+ * @brief   Returns a snapshot of the occupancy statistics.
+ * @details Occupancy histograms, high-water marks and time spent full of
+ *          the MAC descriptor rings, of the receive pbufs and of
+ *          @p PBUF_POOL.
+ * @note    The @p PBUF_POOL high-water mark is the one maintained by lwIP
+ *          on each allocation, the other fields are only as accurate as
+ *          the sampling.
+ *
+ * @param[out] stats    pointer to the statistics to be filled
+ */
+void lwipGetOccupancyStats(lwip_occupancy_stats_t *stats)
+{
+  uint32_t max;
+
+#if MAC_USE_RING_STATISTICS
+  macGetRingStatistics(&ETHD1, &stats->rings);
+#endif
+
+  osalSysLock();
+#if MAC_USE_ZERO_COPY
+  /* Accounting the current interval.*/
+  macOccupancySampleX(&occupancy.rx_pbufs, rx_pbufs_used);
+  stats->rx_pbufs = occupancy.rx_pbufs;
+#else
+  memset(&stats->rx_pbufs, 0, sizeof (stats->rx_pbufs));
+#endif
+  pbuf_pool_sample_i();
+  stats->pbuf_pool = occupancy.pbuf_pool;
+  osalSysUnlock();
+
+  max = (uint32_t)lwip_stats.memp[MEMP_PBUF_POOL]->max;
+  if (max > stats->pbuf_pool.high_water)
+    stats->pbuf_pool.high_water = max;
+}
+
+/**
+ * @brief   Starts or stops the periodic dump of the occupancy statistics.
+ * @details The statistics are printed by the driver thread, one line per
+ *          ring or pool.
+ * @note    The interval is checked on the periodic timer, it is rounded up
+ *          to a multiple of @p LWIP_LINK_POLL_INTERVAL.
+ *
+ * @param[in] chp       stream receiving the dump, @p NULL stops the dump
+ * @param[in] interval  dump interval
+ */
+void lwipStartOccupancyDump(BaseSequentialStream *chp,
+                            sysinterval_t interval)
+{
+  osalSysLock();
+  occupancy.chp      = chp;
+  occupancy.interval = interval;
+  occupancy.last     = osalOsGetSystemTimeX();
+  osalSysUnlock();
+}
+#endif
+
+#if MAC_USE_TIMESTAMPS || defined(__DOXYGEN__)
+/**
+ * @brief   Returns the reception timestamp of a netconn buffer.
+ * @note    The timestamp is the one of the first frame of the buffer.
+ *
+ * @param[in] buf       the netconn buffer, as returned by @p netconn_recv()
+ * @param[out] tsp      pointer to the timestamp to be filled
+ * @return              The timestamp availability.
+ * @retval true         if the timestamp has been returned.
+ * @retval false        if the frame has not been timestamped.
+ */
+bool lwipGetRxTimestamp(const struct netbuf *buf, mactimestamp_t *tsp)
+{
+  if ((buf->p == NULL) || (buf->p->ts_nsec == MAC_TIMESTAMP_INVALID))
+    return false;
+
+  tsp->sec  = buf->p->ts_sec;
+  tsp->nsec = buf->p->ts_nsec;
+
+  return true;
+}
+
+/**
+ * @brief   Returns the transmission timestamp of a netconn buffer.
+ * @details The timestamp becomes available after the MAC completed the
+ *          transmission, the buffer must not be deleted before.
+ * @note    Frames that cannot be transmitted in place are copied by the
+ *          driver and are not timestamped.
+ *
+ * @param[in] buf       the netconn buffer, as passed to @p netconn_send()
+ * @param[out] tsp      pointer to the timestamp to be filled
+ * @return              The timestamp availability.
+ * @retval true         if the timestamp has been returned.
+ * @retval false        if the frame has not been transmitted or timestamped.
+ */
+bool lwipGetTxTimestamp(const struct netbuf *buf, mactimestamp_t *tsp)
+{
+#if MAC_USE_SCATTER_GATHER
+  bool found = false;
+  unsigned i;
+
+  osalSysLock();
+  for (i = 0U; i < LWIP_MAC_TX_TIMESTAMPS; i++) {
+    if ((buf->p != NULL) && (tx_timestamps[i].p == buf->p)) {
+      *tsp  = tx_timestamps[i].ts;
+      found = true;
+      break;
+    }
+  }
+  osalSysUnlock();
+
+  return found;
+#else
+  (void)buf;
+  (void)tsp;
+
+  return false;
+#endif
+}
+#endif
+
 /** @} */
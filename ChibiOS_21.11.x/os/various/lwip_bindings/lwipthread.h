@@ -25,6 +25,7 @@
 #define LWIPTHREAD_H
 
 #include <lwip/opt.h>
+#include <lwip/ip4_addr.h>
 
 /**
  * @brief   lwIP default network interface maximum transmission unit (MTU).
@@ -56,18 +57,76 @@
 
 /**
  * @brief  lwIP thread stack size.
+ * @note   With @p LWIP_TCPIP_CORE_LOCKING the received frames are processed
+ *         by this thread, it needs the stack of the tcpip thread.
  */
 #if !defined(LWIP_THREAD_STACK_SIZE) || defined(__DOXYGEN__)
+#if LWIP_TCPIP_CORE_LOCKING
+#define LWIP_THREAD_STACK_SIZE              TCPIP_THREAD_STACKSIZE
+#else
 #define LWIP_THREAD_STACK_SIZE              672
 #endif
+#endif
 
 /**
- * @brief   Link poll interval.
+ * @brief   Periodic event interval.
+ * @details Collects the MAC statistics and flushes the queued frames, the
+ *          link itself is polled by its own timer.
  */
 #if !defined(LWIP_LINK_POLL_INTERVAL) || defined(__DOXYGEN__)
 #define LWIP_LINK_POLL_INTERVAL             TIME_S2I(5)
 #endif
 
+/**
+ * @brief   Fast link poll interval.
+ * @details While the link is down, and for @p LWIP_LINK_FAST_POLL_COUNT
+ *          polls after a link change, the link is polled at this interval
+ *          instead of @p LWIP_LINK_UP_POLL_INTERVAL.
+ */
+#if !defined(LWIP_LINK_FAST_POLL_INTERVAL) || defined(__DOXYGEN__)
+#define LWIP_LINK_FAST_POLL_INTERVAL        TIME_MS2I(50)
+#endif
+
+/**
+ * @brief   Number of fast link polls after a link change.
+ * @note    Zero disables the fast polling.
+ */
+#if !defined(LWIP_LINK_FAST_POLL_COUNT) || defined(__DOXYGEN__)
+#define LWIP_LINK_FAST_POLL_COUNT           20
+#endif
+
+/**
+ * @brief   Link poll interval while the link is up.
+ * @details Without @p LWIP_LINK_EVENT_LINE an established link is polled
+ *          at this interval, a link loss is detected within it.
+ * @note    Each poll is a few MDIO transactions performed by the driver
+ *          thread, shorter intervals detect a link loss sooner at the cost
+ *          of MDIO traffic and wakeups of the thread draining the receive
+ *          ring. Millisecond detection with no MDIO traffic on a stable link
+ *          requires the PHY interrupt line.
+ */
+#if !defined(LWIP_LINK_UP_POLL_INTERVAL) || defined(__DOXYGEN__)
+#define LWIP_LINK_UP_POLL_INTERVAL          TIME_MS2I(250)
+#endif
+
+/**
+ * @brief   PAL line connected to the PHY interrupt output.
+ * @details If defined the link is polled only on the line events, there is
+ *          no MDIO traffic while the link is stable.
+ * @note    Requires @p PAL_USE_CALLBACKS and a MAC driver programming the
+ *          PHY interrupt, see @p STM32_MAC_PHY_INTERRUPT.
+ */
+#if defined(__DOXYGEN__)
+#define LWIP_LINK_EVENT_LINE                PAL_LINE(GPIOA, 0U)
+#endif
+
+/**
+ * @brief   PAL event mode of the PHY interrupt line.
+ */
+#if !defined(LWIP_LINK_EVENT_MODE) || defined(__DOXYGEN__)
+#define LWIP_LINK_EVENT_MODE                PAL_EVENT_MODE_FALLING_EDGE
+#endif
+
 /**
  *  @brief  IP Address.
  */
@@ -96,6 +155,194 @@
 #define LWIP_SEND_TIMEOUT                   50
 #endif
 
+/**
+ * @brief   Number of receive pbufs wrapping MAC buffers.
+ * @details In zero-copy mode each received frame is passed to the stack as
+ *          a chain of custom pbufs, one per MAC receive buffer spanned by the
+ *          frame, the buffers are returned to the MAC when all the pbufs of
+ *          the frame are freed.
+ * @note    There is no point in having more than the number of MAC receive
+ *          buffers.
+ */
+#if !defined(LWIP_MAC_RX_PBUFS) || defined(__DOXYGEN__)
+#define LWIP_MAC_RX_PBUFS                   4
+#endif
+
+/**
+ * @brief   Receive pbufs kept free in zero-copy mode.
+ * @details Below this threshold the received frames are copied in
+ *          @p PBUF_POOL, the MAC buffers held by the stack cannot stop the
+ *          reception.
+ * @note    Must be lower than @p LWIP_MAC_RX_PBUFS.
+ */
+#if !defined(LWIP_MAC_RX_PBUFS_LOW_WATER) || defined(__DOXYGEN__)
+#define LWIP_MAC_RX_PBUFS_LOW_WATER         1
+#endif
+
+/**
+ * @brief   Receive poll budget.
+ * @details Maximum number of frames taken from the MAC for each receive
+ *          event, when the budget is exhausted the remaining frames are
+ *          processed after serving the other pending events.
+ */
+#if !defined(LWIP_RX_POLL_BUDGET) || defined(__DOXYGEN__)
+#define LWIP_RX_POLL_BUDGET                 16
+#endif
+
+/**
+ * @brief   Prioritized reception.
+ * @details The received frames are classified before taking a receive
+ *          buffer, using the VLAN priority, the IPv4 DSCP and the port rules
+ *          set with @p lwipSetRxRules(). Receive buffers are held back for
+ *          the higher classes so that, under overload, the low classes are
+ *          dropped first.
+ * @note    The receive buffers are the custom pbufs in zero-copy mode and
+ *          @p PBUF_POOL otherwise, the latter requires @p MEMP_STATS.
+ */
+#if !defined(LWIP_RX_PRIORITY) || defined(__DOXYGEN__)
+#define LWIP_RX_PRIORITY                    FALSE
+#endif
+
+/**
+ * @brief   Receive buffers only available to the high class.
+ */
+#if !defined(LWIP_RX_RESERVE_HIGH) || defined(__DOXYGEN__)
+#define LWIP_RX_RESERVE_HIGH                2
+#endif
+
+/**
+ * @brief   Receive buffers not available to the low class, in addition to
+ *          @p LWIP_RX_RESERVE_HIGH.
+ */
+#if !defined(LWIP_RX_RESERVE_NORMAL) || defined(__DOXYGEN__)
+#define LWIP_RX_RESERVE_NORMAL              2
+#endif
+
+/**
+ * @brief   Minimum VLAN priority of the high class.
+ */
+#if !defined(LWIP_RX_HIGH_PCP) || defined(__DOXYGEN__)
+#define LWIP_RX_HIGH_PCP                    5
+#endif
+
+/**
+ * @brief   Minimum DSCP of the high class.
+ * @note    The default includes CS5, EF and the network control classes.
+ */
+#if !defined(LWIP_RX_HIGH_DSCP) || defined(__DOXYGEN__)
+#define LWIP_RX_HIGH_DSCP                   40
+#endif
+
+/**
+ * @brief   Maximum number of receive priority port rules.
+ */
+#if !defined(LWIP_RX_RULES) || defined(__DOXYGEN__)
+#define LWIP_RX_RULES                       4
+#endif
+
+/**
+ * @brief   Size of the receive hand-off queue.
+ * @details The frames taken from the MAC on each receive event are queued
+ *          and passed to the tcpip thread with a single message, the
+ *          tcpip thread then processes them in a loop. When the queue is
+ *          full the frames are left in the MAC until the tcpip thread
+ *          catches up.
+ * @note    Zero disables the queue, each frame is then posted to the
+ *          tcpip thread with @p tcpip_input().
+ * @note    Not used with @p LWIP_TCPIP_CORE_LOCKING, the frames are then
+ *          processed by the lwIP thread with the core locked.
+ */
+#if !defined(LWIP_RX_BATCH_SIZE) || defined(__DOXYGEN__)
+#define LWIP_RX_BATCH_SIZE                  0
+#endif
+
+/**
+ * @brief   Loopback interface.
+ * @details Adds the "lo" interface with address 127.0.0.1/8 beside the
+ *          MAC interface. The sent packets are delivered by the tcpip
+ *          thread, the headers are copied and the payload is passed by
+ *          reference, the local clients of the services use the sockets
+ *          at memory speed.
+ * @note    Replaces the lwIP loopback, @p LWIP_NETIF_LOOPBACK and
+ *          @p LWIP_HAVE_LOOPIF must be disabled.
+ */
+#if !defined(LWIP_LOOPBACK_NETIF) || defined(__DOXYGEN__)
+#define LWIP_LOOPBACK_NETIF                 FALSE
+#endif
+
+/**
+ * @brief   Number of custom pbufs referencing looped back payloads.
+ * @details One is used for each pbuf of the sent chain, when exhausted the
+ *          packets are copied.
+ */
+#if !defined(LWIP_LOOPBACK_PBUFS) || defined(__DOXYGEN__)
+#define LWIP_LOOPBACK_PBUFS                 16
+#endif
+
+/**
+ * @brief   Number of looped back packets waiting for the tcpip thread.
+ */
+#if !defined(LWIP_LOOPBACK_QUEUE_SIZE) || defined(__DOXYGEN__)
+#define LWIP_LOOPBACK_QUEUE_SIZE            8
+#endif
+
+/**
+ * @brief   Number of fast-path UDP flows.
+ * @details Datagrams of a registered flow are delivered by the lwIP thread
+ *          directly into an application objects FIFO, bypassing the tcpip
+ *          thread and the sockets layer.
+ * @note    Zero disables the fast path.
+ * @note    Requires @p CH_CFG_USE_OBJ_FIFOS.
+ */
+#if !defined(LWIP_FASTPATH_FLOWS) || defined(__DOXYGEN__)
+#define LWIP_FASTPATH_FLOWS                 0
+#endif
+
+/**
+ * @brief   Size of the software transmit queue.
+ * @details Frames that do not find free MAC transmit descriptors are queued
+ *          and moved to the descriptors by the TX-complete interrupt, when
+ *          the queue is full the output returns @p ERR_WOULDBLOCK instead
+ *          of waiting.
+ * @note    Zero disables the queue, the output then waits for descriptors
+ *          up to @p LWIP_SEND_TIMEOUT milliseconds.
+ * @note    Requires @p MAC_USE_SCATTER_GATHER.
+ */
+#if !defined(LWIP_MAC_TX_QUEUE_SIZE) || defined(__DOXYGEN__)
+#define LWIP_MAC_TX_QUEUE_SIZE              0
+#endif
+
+/**
+ * @brief   Number of transmission timestamps retained.
+ * @details Timestamps of the transmitted frames are kept, indexed by the
+ *          pbufs of the frame, until overwritten by newer ones.
+ * @note    Only used when @p MAC_USE_TIMESTAMPS is enabled.
+ */
+#if !defined(LWIP_MAC_TX_TIMESTAMPS) || defined(__DOXYGEN__)
+#define LWIP_MAC_TX_TIMESTAMPS              8
+#endif
+
+/**
+ * @brief   Enables the occupancy statistics.
+ * @details The occupancy of the receive pbufs and of @p PBUF_POOL is
+ *          tracked, it is returned by @p lwipGetOccupancyStats() together
+ *          with the occupancy of the MAC descriptor rings.
+ * @note    Requires @p MEMP_STATS.
+ */
+#if !defined(LWIP_OCCUPANCY_STATS) || defined(__DOXYGEN__)
+#define LWIP_OCCUPANCY_STATS                FALSE
+#endif
+
+/**
+ * @brief   Enables the MAC transmit ring stress test.
+ * @details Provides @p lwipMacTxStressTest(), refilling the transmit ring
+ *          from the interrupt faster than the frames are reclaimed.
+ * @note    Requires @p MAC_USE_SCATTER_GATHER.
+ */
+#if !defined(LWIP_MAC_TX_STRESS_TEST) || defined(__DOXYGEN__)
+#define LWIP_MAC_TX_STRESS_TEST             FALSE
+#endif
+
 /**
  * @brief   Link speed.
  */
@@ -235,14 +482,18 @@ typedef struct lwipthread_opts {
   /**
    * @brief   Link up callback.
    *
-   * @note    Called from the tcpip thread when the link goes up.
+   * @note    Called from the tcpip thread when the link goes up, or
+   *          from the lwIP thread with the core locked if
+   *          @p LWIP_TCPIP_CORE_LOCKING is enabled.
    *          Can be NULL to default to lwipDefaultLinkUpCB.
    */
   void (*link_up_cb)(void*);
   /**
    * @brief   Link down callback.
    *
-   * @note    Called from the tcpip thread when the link goes down.
+   * @note    Called from the tcpip thread when the link goes down, or
+   *          from the lwIP thread with the core locked if
+   *          @p LWIP_TCPIP_CORE_LOCKING is enabled.
    *          Can be NULL to default to lwipDefaultLinkDownCB.
    */
   void (*link_down_cb)(void*);
@@ -259,6 +510,248 @@ typedef struct lwipreconf_opts {
   net_addr_mode_t addrMode;
 } lwipreconf_opts_t;
 
+/**
+ * @brief   Receive priority classes.
+ */
+typedef enum {
+  LWIP_RX_CLASS_LOW = 0,            /**< Broadcast and multicast frames.    */
+  LWIP_RX_CLASS_NORMAL = 1,         /**< Default class.                     */
+  LWIP_RX_CLASS_HIGH = 2            /**< Critical traffic.                  */
+} lwip_rx_class_t;
+
+/**
+ * @brief   Number of receive priority classes.
+ */
+#define LWIP_RX_CLASSES                     3
+
+/**
+ * @brief   Receive priority port rule.
+ */
+typedef struct lwip_rx_rule {
+  /**
+   * @brief   @p IP_PROTO_UDP, @p IP_PROTO_TCP or zero for both.
+   */
+  u8_t            proto;
+  /**
+   * @brief   Local port.
+   */
+  u16_t           port;
+  /**
+   * @brief   Class of the matching frames.
+   */
+  lwip_rx_class_t cls;
+} lwip_rx_rule_t;
+
+/**
+ * @brief   Receive polling statistics.
+ */
+typedef struct lwip_rx_stats {
+  /**
+   * @brief   Receive events served by the thread.
+   */
+  uint32_t        polls;
+  /**
+   * @brief   Frames taken from the MAC.
+   */
+  uint32_t        frames;
+  /**
+   * @brief   Polls stopped because the budget was exhausted.
+   */
+  uint32_t        budget_exhausted;
+  /**
+   * @brief   Messages posted to the tcpip thread by the hand-off queue.
+   */
+  uint32_t        batches;
+  /**
+   * @brief   Polls stopped because the hand-off queue was full.
+   */
+  uint32_t        batch_stalls;
+  /**
+   * @brief   Hand-off posts deferred because the tcpip mailbox was full.
+   */
+  uint32_t        batch_deferred;
+  /**
+   * @brief   Frames consumed by the fast-path flows.
+   */
+  uint32_t        fastpath;
+#if MAC_USE_ZERO_COPY || defined(__DOXYGEN__)
+  /**
+   * @brief   Frames copied because the custom pbufs were running low.
+   */
+  uint32_t        copied;
+#endif
+  /**
+   * @brief   Frames dropped because no pbufs were available.
+   */
+  uint32_t        exhausted;
+#if LWIP_RX_PRIORITY || defined(__DOXYGEN__)
+  /**
+   * @brief   Frames received by class.
+   */
+  uint32_t        class_frames[LWIP_RX_CLASSES];
+  /**
+   * @brief   Frames dropped for lack of receive buffers by class.
+   */
+  uint32_t        class_drops[LWIP_RX_CLASSES];
+#endif
+} lwip_rx_stats_t;
+
+#if (LWIP_FASTPATH_FLOWS > 0) || defined(__DOXYGEN__)
+/**
+ * @brief   Datagram delivered by a fast-path flow.
+ */
+typedef struct lwip_fastpath_dgram {
+  /**
+   * @brief   UDP payload, owned by the receiver.
+   */
+  struct pbuf     *p;
+  /**
+   * @brief   Source address.
+   */
+  ip4_addr_t      src_addr;
+  /**
+   * @brief   Source port.
+   */
+  u16_t           src_port;
+  /**
+   * @brief   Monotonic time of the datagram reception by the lwIP thread,
+   *          in microseconds.
+   */
+  uint64_t        rx_time;
+} lwip_fastpath_dgram_t;
+
+/**
+ * @brief   Fast-path UDP flow.
+ */
+typedef struct lwip_fastpath_flow {
+  /**
+   * @brief   Local UDP port.
+   */
+  u16_t           port;
+  /**
+   * @brief   Remote UDP port or zero for any.
+   */
+  u16_t           remote_port;
+  /**
+   * @brief   Remote address or @p IPADDR_ANY for any.
+   */
+  ip4_addr_t      remote_address;
+  /**
+   * @brief   FIFO of @p lwip_fastpath_dgram_t objects.
+   */
+  objects_fifo_t  *ofp;
+  /**
+   * @brief   Datagrams queued into the FIFO.
+   */
+  uint32_t        delivered;
+  /**
+   * @brief   Datagrams dropped because the FIFO was full.
+   */
+  uint32_t        dropped;
+} lwip_fastpath_flow_t;
+#endif
+
+/**
+ * @brief   Software transmit queue statistics.
+ */
+typedef struct lwip_txq_stats {
+  /**
+   * @brief   Frames currently in the queue.
+   */
+  uint32_t        depth;
+  /**
+   * @brief   Maximum number of frames ever in the queue.
+   */
+  uint32_t        max_depth;
+  /**
+   * @brief   Frames that had to be queued.
+   */
+  uint32_t        queued;
+  /**
+   * @brief   Queued frames moved to the MAC from the TX-complete interrupt.
+   */
+  uint32_t        drained_isr;
+  /**
+   * @brief   Frames rejected with @p ERR_WOULDBLOCK because the queue was
+   *          full.
+   */
+  uint32_t        rejected;
+} lwip_txq_stats_t;
+
+/**
+ * @brief   Network interface statistics snapshot.
+ * @details The counters are grouped by the layer where the events are
+ *          detected: MAC hardware, driver thread and lwIP.
+ * @note    Counters of disabled features are left to zero.
+ */
+typedef struct lwip_ifstats {
+#if MAC_USE_STATISTICS || defined(__DOXYGEN__)
+  /**
+   * @brief   MAC hardware counters.
+   */
+  macstatistics_t mac;
+#endif
+  /**
+   * @brief   Receive polling statistics.
+   */
+  lwip_rx_stats_t rx;
+#if (LWIP_MAC_TX_QUEUE_SIZE > 0) || defined(__DOXYGEN__)
+  /**
+   * @brief   Software transmit queue statistics.
+   */
+  lwip_txq_stats_t txq;
+#endif
+  /**
+   * @brief   lwIP link layer counters.
+   */
+  struct {
+    uint32_t      xmit;
+    uint32_t      recv;
+    uint32_t      drop;
+    uint32_t      memerr;
+    uint32_t      err;
+  } link;
+  /**
+   * @brief   MIB2 interface counters.
+   */
+  struct {
+    uint32_t      ifinoctets;
+    uint32_t      ifinucastpkts;
+    uint32_t      ifinnucastpkts;
+    uint32_t      ifindiscards;
+    uint32_t      ifoutoctets;
+    uint32_t      ifoutucastpkts;
+    uint32_t      ifoutnucastpkts;
+    uint32_t      ifoutdiscards;
+  } mib2;
+} lwip_ifstats_t;
+
+/**
+ * @brief   Occupancy statistics snapshot.
+ * @note    See @p macoccupancy_t for the meaning of the fields.
+ */
+typedef struct lwip_occupancy_stats {
+#if MAC_USE_RING_STATISTICS || defined(__DOXYGEN__)
+  /**
+   * @brief   MAC descriptor rings.
+   */
+  macringstatistics_t rings;
+#endif
+  /**
+   * @brief   Custom pbufs wrapping the MAC receive buffers.
+   * @note    Cleared if @p MAC_USE_ZERO_COPY is disabled.
+   */
+  macoccupancy_t  rx_pbufs;
+  /**
+   * @brief   lwIP @p PBUF_POOL.
+   */
+  macoccupancy_t  pbuf_pool;
+} lwip_occupancy_stats_t;
+
+#if MAC_USE_TIMESTAMPS
+struct netbuf;
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -266,6 +759,30 @@ extern "C" {
   void lwipDefaultLinkDownCB(void *p);
   void lwipInit(const lwipthread_opts_t *opts);
   void lwipReconfigure(const lwipreconf_opts_t *opts);
+  void lwipGetRxStats(lwip_rx_stats_t *stats);
+#if LWIP_RX_PRIORITY
+  void lwipSetRxRules(const lwip_rx_rule_t *rules, unsigned n);
+#endif
+#if LWIP_FASTPATH_FLOWS > 0
+  msg_t lwipFastPathRegister(lwip_fastpath_flow_t *fp);
+  void lwipFastPathUnregister(lwip_fastpath_flow_t *fp);
+#endif
+  void lwipGetInterfaceStats(lwip_ifstats_t *stats);
+#if LWIP_MAC_TX_QUEUE_SIZE > 0
+  void lwipGetTxQueueStats(lwip_txq_stats_t *stats);
+#endif
+#if LWIP_MAC_TX_STRESS_TEST
+  bool lwipMacTxStressTest(BaseSequentialStream *chp);
+#endif
+#if LWIP_OCCUPANCY_STATS
+  void lwipGetOccupancyStats(lwip_occupancy_stats_t *stats);
+  void lwipStartOccupancyDump(BaseSequentialStream *chp,
+                              sysinterval_t interval);
+#endif
+#if MAC_USE_TIMESTAMPS
+  bool lwipGetRxTimestamp(const struct netbuf *buf, mactimestamp_t *tsp);
+  bool lwipGetTxTimestamp(const struct netbuf *buf, mactimestamp_t *tsp);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,160 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    monoclock.c
+ * @brief   Monotonic Clock code.
+ * @details The 32 bits realtime counter is extended to 64 bits by
+ *          accumulating the counter increments, a virtual timer samples
+ *          the counter at half its wrap period so that no wrap is missed
+ *          while nobody reads the clock. The microseconds are accumulated
+ *          alongside with the cycles remainder, reading them only costs a
+ *          32 bits division by a constant.
+ *
+ * @addtogroup monotonic_clock
+ * @{
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "monoclock.h"
+
+/*===========================================================================*/
+/* Module local definitions.                                                 */
+/*===========================================================================*/
+
+/**
+ * @brief   Counter sampling period in milliseconds, half the wrap period.
+ */
+#define MCLK_REFRESH_MS                                                     \
+  ((time_msecs_t)((0x80000000ULL * 1000ULL) / MCLK_COUNTER_FREQUENCY))
+
+/*===========================================================================*/
+/* Module exported variables.                                                */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Module local types.                                                       */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Module local variables.                                                   */
+/*===========================================================================*/
+
+static struct {
+  virtual_timer_t       vt;
+  rtcnt_t               last;
+  uint64_t              cycles;
+  uint64_t              us;
+  uint32_t              remainder;
+} mclk;
+
+/*===========================================================================*/
+/* Module local functions.                                                   */
+/*===========================================================================*/
+
+/*
+ * Accounts the counter increment since the previous update, to be called
+ * with the kernel locked.
+ */
+static void mclk_update(void) {
+  rtcnt_t now = chSysGetRealtimeCounterX();
+  uint32_t delta = (uint32_t)(now - mclk.last);
+
+  mclk.last       = now;
+  mclk.cycles    += delta;
+  delta          += mclk.remainder;
+  mclk.us        += delta / MCLK_CYCLES_PER_US;
+  mclk.remainder  = delta % MCLK_CYCLES_PER_US;
+}
+
+static void mclk_vt_cb(virtual_timer_t *vtp, void *p) {
+
+  (void)vtp;
+  (void)p;
+
+  chSysLockFromISR();
+  mclk_update();
+  chSysUnlockFromISR();
+}
+
+/*===========================================================================*/
+/* Module exported functions.                                                */
+/*===========================================================================*/
+
+/**
+ * @brief   Starts the monotonic clock.
+ * @details The clock counts from the start of the realtime counter, the
+ *          function has no effect if the clock is already running.
+ *
+ * @api
+ */
+void mclkInit(void) {
+  rtcnt_t now;
+
+  chSysLock();
+  if (chVTIsArmedI(&mclk.vt)) {
+    chSysUnlock();
+    return;
+  }
+  now = chSysGetRealtimeCounterX();
+  mclk.last      = now;
+  mclk.cycles    = (uint64_t)now;
+  mclk.us        = (uint64_t)(now / MCLK_CYCLES_PER_US);
+  mclk.remainder = (uint32_t)(now % MCLK_CYCLES_PER_US);
+  chVTSetContinuousI(&mclk.vt, TIME_MS2I(MCLK_REFRESH_MS), mclk_vt_cb, NULL);
+  chSysUnlock();
+}
+
+/**
+ * @brief   Returns the realtime counter cycles elapsed.
+ *
+ * @return              The monotonic time in cycles.
+ *
+ * @xclass
+ */
+uint64_t mclkGetCyclesX(void) {
+  syssts_t sts;
+  uint64_t cycles;
+
+  sts = chSysGetStatusAndLockX();
+  mclk_update();
+  cycles = mclk.cycles;
+  chSysRestoreStatusX(sts);
+
+  return cycles;
+}
+
+/**
+ * @brief   Returns the microseconds elapsed.
+ *
+ * @return              The monotonic time in microseconds.
+ *
+ * @xclass
+ */
+uint64_t mclkGetMicrosecondsX(void) {
+  syssts_t sts;
+  uint64_t us;
+
+  sts = chSysGetStatusAndLockX();
+  mclk_update();
+  us = mclk.us;
+  chSysRestoreStatusX(sts);
+
+  return us;
+}
+
+/** @} */
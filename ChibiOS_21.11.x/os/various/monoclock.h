@@ -0,0 +1,134 @@
+/*
+    ChibiOS - Copyright (C) 2006..2018 Giovanni Di Sirio
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+        http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+*/
+
+/**
+ * @file    monoclock.h
+ * @brief   Monotonic Clock structures and macros.
+ *
+ * @addtogroup monotonic_clock
+ * @{
+ */
+
+#ifndef MONOCLOCK_H
+#define MONOCLOCK_H
+
+/*===========================================================================*/
+/* Module constants.                                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Module pre-compile time settings.                                         */
+/*===========================================================================*/
+
+/**
+ * @brief   Realtime counter frequency in Hz.
+ * @note    The default is the core clock, the counter being the DWT cycle
+ *          counter, or 1MHz on the simulator.
+ */
+#if !defined(MCLK_COUNTER_FREQUENCY) || defined(__DOXYGEN__)
+#if defined(STM32_CORE_CK)
+#define MCLK_COUNTER_FREQUENCY              STM32_CORE_CK
+#elif defined(PORT_ARCHITECTURE_SIMIA32)
+#define MCLK_COUNTER_FREQUENCY              1000000U
+#endif
+#endif
+
+/*===========================================================================*/
+/* Derived constants and error checks.                                       */
+/*===========================================================================*/
+
+/*
+ * Module dependencies check.
+ */
+#if !PORT_SUPPORTS_RT
+#error "Monotonic Clock requires a realtime counter"
+#endif
+
+#if !defined(MCLK_COUNTER_FREQUENCY)
+#error "MCLK_COUNTER_FREQUENCY not defined"
+#endif
+
+#if (MCLK_COUNTER_FREQUENCY < 1000000U) ||                                  \
+    ((MCLK_COUNTER_FREQUENCY % 1000000U) != 0U)
+#error "MCLK_COUNTER_FREQUENCY must be a multiple of 1MHz"
+#endif
+
+/**
+ * @brief   Realtime counter cycles per microsecond.
+ */
+#define MCLK_CYCLES_PER_US                                                  \
+  ((uint32_t)(MCLK_COUNTER_FREQUENCY / 1000000U))
+
+/*===========================================================================*/
+/* Module data structures and types.                                         */
+/*===========================================================================*/
+
+/*===========================================================================*/
+/* Module macros.                                                            */
+/*===========================================================================*/
+
+/**
+ * @name    Time conversion utilities
+ * @{
+ */
+/**
+ * @brief   Cycles to microseconds, rounded down.
+ */
+#define MCLK_C2US(c)        ((uint64_t)(c) / MCLK_CYCLES_PER_US)
+
+/**
+ * @brief   Microseconds to cycles.
+ */
+#define MCLK_US2C(us)       ((uint64_t)(us) * MCLK_CYCLES_PER_US)
+
+/**
+ * @brief   Microseconds to milliseconds, rounded down.
+ */
+#define MCLK_US2MS(us)      ((uint64_t)(us) / 1000U)
+
+/**
+ * @brief   Seconds part of a microseconds time, for printing.
+ */
+#define MCLK_US2S(us)       ((uint32_t)((uint64_t)(us) / 1000000U))
+
+/**
+ * @brief   Microseconds within the second of a microseconds time, for
+ *          printing.
+ */
+#define MCLK_US2SFRAC(us)   ((uint32_t)((uint64_t)(us) % 1000000U))
+/** @} */
+
+/*===========================================================================*/
+/* External declarations.                                                    */
+/*===========================================================================*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+  void mclkInit(void);
+  uint64_t mclkGetCyclesX(void);
+  uint64_t mclkGetMicrosecondsX(void);
+#ifdef __cplusplus
+}
+#endif
+
+/*===========================================================================*/
+/* Module inline functions.                                                  */
+/*===========================================================================*/
+
+#endif /* MONOCLOCK_H */
+
+/** @} */
@@ -328,7 +328,42 @@
  * @brief   Enables the zero-copy API.
  */
 #if !defined(MAC_USE_ZERO_COPY) || defined(__DOXYGEN__)
-#define MAC_USE_ZERO_COPY                   FALSE
+#define MAC_USE_ZERO_COPY                   TRUE
+#endif
+
+/**
+ * @brief   Enables the scatter-gather transmit API.
+ */
+#if !defined(MAC_USE_SCATTER_GATHER) || defined(__DOXYGEN__)
+#define MAC_USE_SCATTER_GATHER              TRUE
+#endif
+
+/**
+ * @brief   Enables the hardware receive filters API.
+ */
+#if !defined(MAC_USE_FILTERS) || defined(__DOXYGEN__)
+#define MAC_USE_FILTERS                     TRUE
+#endif
+
+/**
+ * @brief   Enables the hardware statistics API.
+ */
+#if !defined(MAC_USE_STATISTICS) || defined(__DOXYGEN__)
+#define MAC_USE_STATISTICS                  TRUE
+#endif
+
+/**
+ * @brief   Enables the descriptor rings occupancy statistics API.
+ */
+#if !defined(MAC_USE_RING_STATISTICS) || defined(__DOXYGEN__)
+#define MAC_USE_RING_STATISTICS             TRUE
+#endif
+
+/**
+ * @brief   Enables the IEEE 1588 timestamping API.
+ */
+#if !defined(MAC_USE_TIMESTAMPS) || defined(__DOXYGEN__)
+#define MAC_USE_TIMESTAMPS                  TRUE
 #endif
 
 /**
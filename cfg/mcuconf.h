@@ -322,13 +322,23 @@
 /*
  * MAC driver system settings.
  */
-#define STM32_MAC_TRANSMIT_BUFFERS          2
-#define STM32_MAC_RECEIVE_BUFFERS           4
+#define STM32_MAC_TRANSMIT_BUFFERS          8
+#define STM32_MAC_TRANSMIT_COOKIES          24
+#define STM32_MAC_RECEIVE_BUFFERS           32
 #define STM32_MAC_BUFFERS_SIZE              1522
+#define STM32_MAC_RX_BUFFERS_SIZE           512
+#define STM32_MAC_BUFFERS_CACHED            TRUE
 #define STM32_MAC_PHY_TIMEOUT               1000
 #define STM32_MAC_ETH1_CHANGE_PHY_STATE     TRUE
 #define STM32_MAC_ETH1_IRQ_PRIORITY         13
-#define STM32_MAC_IP_CHECKSUM_OFFLOAD       0
+#define STM32_MAC_IP_CHECKSUM_OFFLOAD       3
+#define STM32_MAC_RX_COALESCING             TRUE
+#define STM32_MAC_RX_FRAMES_THRESHOLD       4
+#define STM32_MAC_RX_WATCHDOG               128
+#define STM32_MAC_FLOW_CONTROL              TRUE
+#define STM32_MAC_PAUSE_TIME                256
+#define STM32_MAC_RX_FC_ACTIVATE            0
+#define STM32_MAC_RX_FC_DEACTIVATE          1
 
 /*
  * PWM driver system settings.
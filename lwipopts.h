@@ -51,7 +51,7 @@
  * allocation and deallocation.
  */
 #ifndef SYS_LIGHTWEIGHT_PROT
-#define SYS_LIGHTWEIGHT_PROT            0
+#define SYS_LIGHTWEIGHT_PROT            1
 #endif
 
 /**
@@ -70,6 +70,17 @@
 #define NO_SYS_NO_TIMERS                0
 #endif
 
+/**
+ * LWIP_TIMERS_CUSTOM==1: the lwIP timers are ChibiOS virtual timers provided
+ * by sys_arch.c, each posts to the tcpip thread only when it expires with
+ * work pending: the TCP, ARP, reassembly and IGMP timers are skipped while
+ * their pcbs, entries, datagrams or delayed reports are none.
+ * CH_LWIP_SYS_TIMEOUTS sets the number of sys_timeout() timeouts.
+ */
+#ifndef LWIP_TIMERS_CUSTOM
+#define LWIP_TIMERS_CUSTOM              1
+#endif
+
 /**
  * MEMCPY: override this if you have a faster implementation at hand than the
  * one included in your C library
@@ -123,7 +134,7 @@
  * a lot of data that needs to be copied, this should be set high.
  */
 #ifndef MEM_SIZE
-#define MEM_SIZE                        1600
+#define MEM_SIZE                        16384
 #endif
 
 /**
@@ -796,7 +807,7 @@
  * LWIP_IGMP==1: Turn on IGMP module.
  */
 #ifndef LWIP_IGMP
-#define LWIP_IGMP                       0
+#define LWIP_IGMP                       1
 #endif
 
 /*
@@ -947,7 +958,7 @@
  * an upper limit on the MSS advertised by the remote host.
  */
 #ifndef TCP_MSS
-#define TCP_MSS                         536
+#define TCP_MSS                         1460
 #endif
 
 /**
@@ -968,7 +979,7 @@
  * To achieve good performance, this should be at least 2 * TCP_MSS.
  */
 #ifndef TCP_SND_BUF
-#define TCP_SND_BUF                     (2 * TCP_MSS)
+#define TCP_SND_BUF                     (4 * TCP_MSS)
 #endif
 
 /**
@@ -1008,9 +1019,11 @@
 /**
  * TCP_OOSEQ_MAX_PBUFS: The maximum number of pbufs queued on ooseq per pcb.
  * Default is 0 (no limit). Only valid for TCP_QUEUE_OOSEQ==0.
+ * Limited because the out of sequence segments hold receive buffers, a
+ * full size frame spans three of them in zero-copy mode.
  */
 #ifndef TCP_OOSEQ_MAX_PBUFS
-#define TCP_OOSEQ_MAX_PBUFS             0
+#define TCP_OOSEQ_MAX_PBUFS             12
 #endif
 
 /**
@@ -1098,6 +1111,14 @@
 #define PBUF_POOL_BUFSIZE               LWIP_MEM_ALIGN_SIZE(TCP_MSS+40+PBUF_LINK_HLEN)
 #endif
 
+/**
+ * LWIP_PBUF_CUSTOM_DATA: Store private data on pbufs, the MAC reception
+ * timestamp is stored here by the ChibiOS bindings.
+ */
+#ifndef LWIP_PBUF_CUSTOM_DATA
+#define LWIP_PBUF_CUSTOM_DATA           u32_t ts_sec; u32_t ts_nsec;
+#endif
+
 /*
    ------------------------------------------------
    ---------- Network Interfaces options ----------
@@ -1379,16 +1400,18 @@
    ----------------------------------------------
 */
 /**
- * LWIP_TCPIP_CORE_LOCKING: (EXPERIMENTAL!)
- * Don't use it if you're not an active lwIP project member
+ * LWIP_TCPIP_CORE_LOCKING: Acquire the core lock (a priority inheritance
+ * mutex) for the API calls instead of posting them to the tcpip thread.
+ * Received frames are processed by the driver thread with the core locked.
  */
 #ifndef LWIP_TCPIP_CORE_LOCKING
-#define LWIP_TCPIP_CORE_LOCKING         0
+#define LWIP_TCPIP_CORE_LOCKING         1
 #endif
 
 /**
- * LWIP_TCPIP_CORE_LOCKING_INPUT: (EXPERIMENTAL!)
- * Don't use it if you're not an active lwIP project member
+ * LWIP_TCPIP_CORE_LOCKING_INPUT: Process tcpip_input() calls with the core
+ * locked. Not needed by the MAC driver thread, it does not use tcpip_input()
+ * when LWIP_TCPIP_CORE_LOCKING is enabled.
  */
 #ifndef LWIP_TCPIP_CORE_LOCKING_INPUT
 #define LWIP_TCPIP_CORE_LOCKING_INPUT   0
@@ -1513,6 +1536,20 @@
 #define LWIP_STATS_DISPLAY              0
 #endif
 
+/**
+ * LWIP_STATS_LARGE==1: Use 32 bits counters instead of 16.
+ */
+#ifndef LWIP_STATS_LARGE
+#define LWIP_STATS_LARGE                1
+#endif
+
+/**
+ * MIB2_STATS==1: Stats for SNMP MIB2.
+ */
+#ifndef MIB2_STATS
+#define MIB2_STATS                      1
+#endif
+
 /**
  * LINK_STATS==1: Enable link stats.
  */
@@ -1778,6 +1815,15 @@
    ---------- Checksum options ----------
    --------------------------------------
 */
+/**
+ * LWIP_CHECKSUM_CTRL_PER_NETIF==1: Checksum generation/check can be enabled/disabled
+ * per netif, the MAC interface disables the checksums done by the hardware.
+ * ATTENTION: if enabled, the CHECKSUM_GEN_* and CHECKSUM_CHECK_* defines must be enabled!
+ */
+#ifndef LWIP_CHECKSUM_CTRL_PER_NETIF
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
+#endif
+
 /**
  * CHECKSUM_GEN_IP==1: Generate checksums in software for outgoing IP packets.
  */
@@ -1830,9 +1876,23 @@
 /**
  * LWIP_CHECKSUM_ON_COPY==1: Calculate checksum when copying data from
  * application buffers to pbufs.
+ * The copy and the checksum are a single pass with the ChibiOS checksum
+ * routines (CH_LWIP_USE_ARCH_CHKSUM).
  */
 #ifndef LWIP_CHECKSUM_ON_COPY
-#define LWIP_CHECKSUM_ON_COPY           0
+#define LWIP_CHECKSUM_ON_COPY           1
+#endif
+
+/**
+ * CH_LWIP_CHKSUM_BENCHMARK==1: print at startup a comparison of the ChibiOS
+ * checksum routines with the lwIP generic one, built for the occasion.
+ */
+#ifndef CH_LWIP_CHKSUM_BENCHMARK
+#define CH_LWIP_CHKSUM_BENCHMARK        0
+#endif
+
+#if CH_LWIP_CHKSUM_BENCHMARK && !defined(LWIP_CHKSUM_ALGORITHM)
+#define LWIP_CHKSUM_ALGORITHM           2
 #endif
 
 /*
@@ -1863,6 +1923,147 @@
  * that case, ip_route() continues as normal.
  */
 
+/*
+   ---------------------------------------
+   ---------- ChibiOS bindings options ---
+   ---------------------------------------
+*/
+/**
+ * CH_LWIP_USE_MEM_POOLS==1: allocate the sys_arch semaphores, mutexes,
+ * mailboxes and threads from memory pools instead of the heap, mailboxes
+ * and thread stacks use size classes taken from the mailbox and stack sizes
+ * configured above.
+ */
+#ifndef CH_LWIP_USE_MEM_POOLS
+#define CH_LWIP_USE_MEM_POOLS           1
+#endif
+
+/**
+ * CH_LWIP_USE_LOCKFREE_MBOX==1: use the lock-free mailboxes, posting does not
+ * enter the kernel unless the consumer is waiting. Requires a single consumer
+ * per mailbox, sockets must not be read by several threads at once.
+ */
+#ifndef CH_LWIP_USE_LOCKFREE_MBOX
+#define CH_LWIP_USE_LOCKFREE_MBOX       0
+#endif
+
+/**
+ * CH_LWIP_MBOX_MEASURE==1: measure the mailbox posts and fetches, see
+ * sys_arch_get_mbox_stats(), to compare both mailbox implementations.
+ */
+#ifndef CH_LWIP_MBOX_MEASURE
+#define CH_LWIP_MBOX_MEASURE            0
+#endif
+
+/**
+ * LWIP_MAC_RX_PBUFS: number of custom pbufs wrapping MAC receive buffers in
+ * zero-copy mode, one per receive descriptor (STM32_MAC_RECEIVE_BUFFERS).
+ */
+#ifndef LWIP_MAC_RX_PBUFS
+#define LWIP_MAC_RX_PBUFS               32
+#endif
+
+/**
+ * LWIP_MAC_RX_PBUFS_LOW_WATER: number of custom pbufs kept free in zero-copy
+ * mode, below this threshold the received frames are copied in PBUF_POOL
+ * so that the MAC buffers held by the stack cannot stop the reception.
+ */
+#ifndef LWIP_MAC_RX_PBUFS_LOW_WATER
+#define LWIP_MAC_RX_PBUFS_LOW_WATER     8
+#endif
+
+/**
+ * LWIP_RX_POLL_BUDGET: maximum number of frames taken from the MAC each time
+ * the lwIP thread wakes up on reception.
+ */
+#ifndef LWIP_RX_POLL_BUDGET
+#define LWIP_RX_POLL_BUDGET             8
+#endif
+
+/**
+ * LWIP_RX_BATCH_SIZE: number of received frames handed to the tcpip thread
+ * with a single message, zero posts each frame with tcpip_input(). Not used
+ * with LWIP_TCPIP_CORE_LOCKING.
+ */
+#ifndef LWIP_RX_BATCH_SIZE
+#define LWIP_RX_BATCH_SIZE              16
+#endif
+
+/**
+ * LWIP_RX_PRIORITY==1: classify the received frames by VLAN priority, DSCP
+ * and port rules (lwipSetRxRules()), receive buffers are held back for the
+ * higher classes.
+ */
+#ifndef LWIP_RX_PRIORITY
+#define LWIP_RX_PRIORITY                1
+#endif
+
+/**
+ * LWIP_RX_RESERVE_HIGH: receive buffers only available to the high class.
+ */
+#ifndef LWIP_RX_RESERVE_HIGH
+#define LWIP_RX_RESERVE_HIGH            4
+#endif
+
+/**
+ * LWIP_RX_RESERVE_NORMAL: receive buffers not available to the low class,
+ * in addition to LWIP_RX_RESERVE_HIGH.
+ */
+#ifndef LWIP_RX_RESERVE_NORMAL
+#define LWIP_RX_RESERVE_NORMAL          4
+#endif
+
+/**
+ * LWIP_LOOPBACK_NETIF==1: add the "lo" interface (127.0.0.1/8), the payload
+ * of the looped back packets is passed by reference. It replaces
+ * LWIP_HAVE_LOOPIF.
+ */
+#ifndef LWIP_LOOPBACK_NETIF
+#define LWIP_LOOPBACK_NETIF             1
+#endif
+
+/**
+ * LWIP_FASTPATH_FLOWS: number of UDP flows that can be registered with
+ * lwipFastPathRegister(), their datagrams are delivered by the lwIP thread
+ * directly to an application FIFO.
+ */
+#ifndef LWIP_FASTPATH_FLOWS
+#define LWIP_FASTPATH_FLOWS             2
+#endif
+
+/**
+ * LWIP_MAC_TX_QUEUE_SIZE: number of frames queued in software when all the
+ * MAC transmit descriptors are busy, the output returns ERR_WOULDBLOCK when
+ * the queue is full instead of blocking the tcpip thread.
+ */
+#ifndef LWIP_MAC_TX_QUEUE_SIZE
+#define LWIP_MAC_TX_QUEUE_SIZE          8
+#endif
+
+/**
+ * LWIP_MAC_TX_TIMESTAMPS: number of transmission timestamps retained for
+ * lwipGetTxTimestamp().
+ */
+#ifndef LWIP_MAC_TX_TIMESTAMPS
+#define LWIP_MAC_TX_TIMESTAMPS          8
+#endif
+
+/**
+ * LWIP_MAC_TX_STRESS_TEST==1: provide lwipMacTxStressTest(), refilling the
+ * MAC transmit ring from the interrupt faster than the frames are reclaimed.
+ */
+#ifndef LWIP_MAC_TX_STRESS_TEST
+#define LWIP_MAC_TX_STRESS_TEST         0
+#endif
+
+/**
+ * LWIP_OCCUPANCY_STATS==1: track the occupancy of the receive pbufs and of
+ * PBUF_POOL for lwipGetOccupancyStats() and lwipStartOccupancyDump().
+ */
+#ifndef LWIP_OCCUPANCY_STATS
+#define LWIP_OCCUPANCY_STATS            1
+#endif
+
 /*
    ---------------------------------------
    ---------- Debugging options ----------
@@ -21,12 +21,23 @@
 #include "lwip/netdb.h"
 #include "lwip/netif.h"
 #include "chprintf.h"
+#include "monoclock.h"
 #include "SEGGER_RTT_Channel.h"
 
 #define LWIP_PORT_INIT_IPADDR(addr)   IP4_ADDR((addr), 192,168,1,200)
 #define LWIP_PORT_INIT_GW(addr)       IP4_ADDR((addr), 192,168,1,1)
 #define LWIP_PORT_INIT_NETMASK(addr)  IP4_ADDR((addr), 255,255,255,0)
 
+/*
+ * Log line on the RTT channel, prefixed with the monotonic time in seconds
+ * with microseconds resolution.
+ */
+#define LOG(...) do {                                                       \
+  uint64_t log_now = mclkGetMicrosecondsX();                                \
+  chprintf((BaseSequentialStream *)&RTT_S0, "[%u.%06u] ",                   \
+           MCLK_US2S(log_now), MCLK_US2SFRAC(log_now));                     \
+  chprintf((BaseSequentialStream *)&RTT_S0, __VA_ARGS__);                   \
+} while (false)
 
 /*
  * This is a periodic thread that does absolutely nothing except flashing
@@ -48,11 +59,61 @@ static THD_FUNCTION(Thread1, arg) {
 // UDP Server Configuration
 #define UDP_SERVER_PORT    12345
 #define UDP_BUFFER_SIZE    1024
+#define UDP_QUEUE_SIZE     8
 
 /*
  * UDP Server Thread
  */
 static THD_WORKING_AREA(waUdpServer, 2048);
+#if LWIP_FASTPATH_FLOWS > 0
+/*
+ * The datagrams are delivered by the lwIP thread through a fast-path flow,
+ * bypassing the tcpip thread and the sockets layer.
+ */
+static lwip_fastpath_dgram_t udp_dgrams[UDP_QUEUE_SIZE];
+static msg_t udp_msgs[UDP_QUEUE_SIZE];
+static objects_fifo_t udp_fifo;
+static lwip_fastpath_flow_t udp_flow;
+
+static THD_FUNCTION(UdpServerThread, arg) {
+  (void)arg;
+  chRegSetThreadName("udp_server");
+
+  uint8_t buffer[UDP_BUFFER_SIZE];
+
+  chFifoObjectInit(&udp_fifo, sizeof(lwip_fastpath_dgram_t), UDP_QUEUE_SIZE,
+                   udp_dgrams, udp_msgs);
+  udp_flow.port = UDP_SERVER_PORT;
+  udp_flow.ofp = &udp_fifo;
+  if (lwipFastPathRegister(&udp_flow) != MSG_OK) {
+    LOG("Failed to register UDP flow\n");
+    return;
+  }
+
+  LOG("UDP Server started on port %d\n", UDP_SERVER_PORT);
+
+  while (true) {
+    lwip_fastpath_dgram_t *dgp;
+    u16_t bytes_received;
+
+    // Wait for incoming data
+    (void)chFifoReceiveObjectTimeout(&udp_fifo, (void **)&dgp, TIME_INFINITE);
+    bytes_received = pbuf_copy_partial(dgp->p, buffer, UDP_BUFFER_SIZE - 1, 0);
+    buffer[bytes_received] = '\0';  // Null-terminate the string
+
+    // Print received data, client info and delivery latency
+    LOG("Received from %d.%d.%d.%d:%d (+%uus): %s\n",
+        ip4_addr1(&dgp->src_addr), ip4_addr2(&dgp->src_addr),
+        ip4_addr3(&dgp->src_addr), ip4_addr4(&dgp->src_addr),
+        dgp->src_port,
+        (unsigned)(mclkGetMicrosecondsX() - dgp->rx_time),
+        buffer);
+
+    pbuf_free(dgp->p);
+    chFifoReturnObject(&udp_fifo, dgp);
+  }
+}
+#else
 static THD_FUNCTION(UdpServerThread, arg) {
   (void)arg;
   chRegSetThreadName("udp_server");
@@ -66,7 +127,7 @@ static THD_FUNCTION(UdpServerThread, arg) {
   // Create UDP socket
   sock = socket(AF_INET, SOCK_DGRAM, 0);
   if (sock < 0) {
-    chprintf((BaseSequentialStream *)&RTT_S0, "Failed to create UDP socket\n");
+    LOG("Failed to create UDP socket\n");
     return;
   }
   
@@ -78,12 +139,12 @@ static THD_FUNCTION(UdpServerThread, arg) {
   
   // Bind socket to address
   if (bind(sock, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-    chprintf((BaseSequentialStream *)&RTT_S0, "Failed to bind UDP socket to port %d\n", UDP_SERVER_PORT);
+    LOG("Failed to bind UDP socket to port %d\n", UDP_SERVER_PORT);
     close(sock);
     return;
   }
   
-  chprintf((BaseSequentialStream *)&RTT_S0, "UDP Server started on port %d\n", UDP_SERVER_PORT);
+  LOG("UDP Server started on port %d\n", UDP_SERVER_PORT);
   
   while (true) {
     // Wait for incoming data
@@ -94,33 +155,32 @@ static THD_FUNCTION(UdpServerThread, arg) {
       buffer[bytes_received] = '\0';  // Null-terminate the string
       
       // Print received data and client info
-      chprintf((BaseSequentialStream *)&RTT_S0, 
-               "Received from %d.%d.%d.%d:%d: %s\n",
-               (client_addr.sin_addr.s_addr >> 0) & 0xFF,
-               (client_addr.sin_addr.s_addr >> 8) & 0xFF,
-               (client_addr.sin_addr.s_addr >> 16) & 0xFF,
-               (client_addr.sin_addr.s_addr >> 24) & 0xFF,
-               ntohs(client_addr.sin_port),
-               buffer);
+      LOG("Received from %d.%d.%d.%d:%d: %s\n",
+          (client_addr.sin_addr.s_addr >> 0) & 0xFF,
+          (client_addr.sin_addr.s_addr >> 8) & 0xFF,
+          (client_addr.sin_addr.s_addr >> 16) & 0xFF,
+          (client_addr.sin_addr.s_addr >> 24) & 0xFF,
+          ntohs(client_addr.sin_port),
+          buffer);
     }
     else if (bytes_received < 0) {
-      chprintf((BaseSequentialStream *)&RTT_S0, "Error receiving UDP data\n");
+      LOG("Error receiving UDP data\n");
       chThdSleepMilliseconds(100);
     }
   }
 }
+#endif
 
 void myLinkUpCallback(void *p) {
   struct netif *ifc = (struct netif*) p;
-  chprintf((BaseSequentialStream *)&RTT_S0, 
-           "Ethernet reconnected! IP: %d.%d.%d.%d\n",
-           ip4_addr1(&ifc->ip_addr), ip4_addr2(&ifc->ip_addr),
-           ip4_addr3(&ifc->ip_addr), ip4_addr4(&ifc->ip_addr));
+  LOG("Ethernet reconnected! IP: %d.%d.%d.%d\n",
+      ip4_addr1(&ifc->ip_addr), ip4_addr2(&ifc->ip_addr),
+      ip4_addr3(&ifc->ip_addr), ip4_addr4(&ifc->ip_addr));
 }
 
 void myLinkDownCallback(void *p) {
   (void)p;
-  chprintf((BaseSequentialStream *)&RTT_S0, "Ethernet disconnected!\n");
+  LOG("Ethernet disconnected!\n");
 }
 
 /*
@@ -137,6 +197,16 @@ int main(void) {
   halInit();
   chSysInit();
   RTTchannelObjectInit(&RTT_S0);
+  mclkInit();
+
+#if CH_LWIP_CHKSUM_BENCHMARK
+  lwip_arch_chksum_benchmark((BaseSequentialStream *)&RTT_S0);
+#endif
+
+#if LWIP_MAC_TX_STRESS_TEST
+  // Runs on the MAC driver before lwIP takes it over
+  (void)lwipMacTxStressTest((BaseSequentialStream *)&RTT_S0);
+#endif
 
   uint8_t mac_address[6] = {0x02, 0x12, 0x13, 0x10, 0x15, 0x05};
 
@@ -159,6 +229,19 @@ int main(void) {
   
   lwipInit(&lwipthread_opts);
 
+#if LWIP_RX_PRIORITY
+  // The UDP server requests are critical, kept flowing under overload
+  static const lwip_rx_rule_t rx_rules[] = {
+      {.proto = IPPROTO_UDP, .port = UDP_SERVER_PORT, .cls = LWIP_RX_CLASS_HIGH}
+  };
+  lwipSetRxRules(rx_rules, sizeof(rx_rules) / sizeof(rx_rules[0]));
+#endif
+
+#if LWIP_OCCUPANCY_STATS
+  // Periodic dump of the rings and pools occupancy
+  lwipStartOccupancyDump((BaseSequentialStream *)&RTT_S0, TIME_S2I(60));
+#endif
+
   /*
    * Creates the example threads.
    */